@@ -0,0 +1,645 @@
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cargparse.h"
+#include "cargparse_getopt.h"
+#include "counters.h"
+
+/* Parse, getter and completion timings over synthetic specs, one JSON object per line on stdout:
+ *
+ *   {"bench":"parse","impl":"getopt_long","options":100,"tokens":1000,"mix":"long",...}
+ *
+ * Specs of n options are: "ints" (INT, one or more), then STR "opt-<i>" and BOOL "flag-<i>" in turns, the
+ * first 52 of them with a short name, and "files" (POS, zero or more). getopt_long gets the same names,
+ * with values after "--ints" and positionals both left as non-options, and so does the cargparse_getopt_long
+ * shim ("impl":"cargparse_getopt"). "impl":"cargparse_feed" feeds the argv of cargparse_parse one token at a
+ * time through cargparse_parse_feed. "impl":"cargparse_lazy" parses the numeric mix with cargparse_set_lazy
+ * and reads its first number.
+ *
+ * "line" splits and parses a text command of up to 16 options, as a command server would, into a parser
+ * bound to the spec. "visit" finds what a 7 token command line set, through the event log ("impl":"events")
+ * or by asking the getters for every option ("impl":"getters").
+ *
+ * With --counters every region (prepare, parse, get, help, complete, line, visit) is also measured with
+ * hardware counters where perf_event_open provides them, reported per op and per item (token, value or
+ * option). */
+
+#define BENCH_SHORT_NAMES "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+#define BENCH_N_SHORT_NAMES 52
+#define BENCH_NAME_LEN 16
+#define BENCH_TOKEN_LEN 24
+#define BENCH_TOKENS_PER_RUN 2000000 /* split across iterations of one measurement */
+#define BENCH_MIN_ITERATIONS 3
+#define BENCH_MAX_ITERATIONS 100000
+#define BENCH_COMPLETE_QUERIES 2000
+#define BENCH_LINE_OPTIONS 16 /* options in the command line of _bench_line */
+#define BENCH_LINE_LEN 512
+#define BENCH_LAZY_VALUES 16 /* memo of _bench_lazy, covering the start of argv */
+
+typedef enum {
+    BENCH_MIX_LONG = 0, /* --opt-<i> value */
+    BENCH_MIX_SHORT,    /* -a value */
+    BENCH_MIX_CLUSTER,  /* -bdfh */
+    BENCH_MIX_NUMERIC,  /* --ints 1 2 3 ... -- */
+    BENCH_MIX_POS,      /* file file ... */
+    BENCH_N_MIXES,
+} bench_mix_e;
+
+static const char *const MIX_NAMES[] = {"long", "short", "clustered", "numeric", "positional"};
+static const int SPEC_SIZES[] = {10, 100, 1000, 10000};
+static const int TOKEN_COUNTS[] = {10, 1000, 100000, 1000000};
+
+typedef struct {
+    int n_options;
+    char (*names)[BENCH_NAME_LEN];
+    cargparse_builder_t builder;
+    cargparse_t parser;
+    struct option *longopts;
+    char shortopts[2 * BENCH_N_SHORT_NAMES + 1];
+} bench_spec_t;
+
+typedef struct {
+    int argc;
+    char **argv;
+    char **scratch; /* getopt_long permutes its argv */
+    char *strings;
+} bench_argv_t;
+
+static volatile long sink;
+static bench_counters_t counters;
+static bool with_counters;
+
+static int
+_bench_iterations(const int tokens) {
+    int iters = BENCH_TOKENS_PER_RUN / tokens;
+
+    if (iters < BENCH_MIN_ITERATIONS) return BENCH_MIN_ITERATIONS;
+    return iters > BENCH_MAX_ITERATIONS ? BENCH_MAX_ITERATIONS : iters;
+}
+
+static int
+_bench_spec_init(bench_spec_t *spec, const int n_options) {
+    int i, n_short = 0, n_long = 0, nargs;
+    char short_name;
+    size_t len = 0;
+    cargparse_option_type_e type;
+
+    memset(spec, 0, sizeof(*spec));
+    spec->n_options = n_options;
+    spec->names = malloc(BENCH_NAME_LEN * (size_t)n_options);
+    spec->longopts = calloc((size_t)n_options, sizeof(struct option));
+    if (!spec->names || !spec->longopts) return -1;
+
+    cargparse_builder_init(&spec->builder, NULL, NULL, NULL);
+    for (i = 0; i < n_options; i++) {
+        short_name = CARGPARSE_NO_SHORT;
+        nargs = 1;
+        if (i == 0) {
+            strcpy(spec->names[i], "ints");
+            type = CARGPARSE_OPTION_TYPE_INT;
+            nargs = CARGPARSE_NARGS_ONE_OR_MORE;
+        } else if (i == n_options - 1) {
+            strcpy(spec->names[i], "files");
+            type = CARGPARSE_OPTION_TYPE_POS;
+            nargs = CARGPARSE_NARGS_ZERO_OR_MORE;
+        } else {
+            type = i % 2 ? CARGPARSE_OPTION_TYPE_STR : CARGPARSE_OPTION_TYPE_BOOL;
+            sprintf(spec->names[i], "%s-%d", i % 2 ? "opt" : "flag", i);
+            if (n_short < BENCH_N_SHORT_NAMES) {
+                short_name = BENCH_SHORT_NAMES[n_short++];
+                spec->shortopts[len++] = short_name;
+                if (type == CARGPARSE_OPTION_TYPE_STR) spec->shortopts[len++] = ':';
+            }
+        }
+        {
+            const cargparse_option_t opt = {type, short_name, spec->names[i], "value of a synthetic option",
+                                            CARGPARSE_FLAG_NONE, nargs};
+
+            if (cargparse_builder_add(&spec->builder, &opt) != CARGPARSE_OK) return -1;
+        }
+
+        if (type != CARGPARSE_OPTION_TYPE_POS) {
+            spec->longopts[n_long].name = spec->names[i];
+            spec->longopts[n_long].has_arg =
+                type == CARGPARSE_OPTION_TYPE_BOOL ? no_argument : required_argument;
+            spec->longopts[n_long].val = short_name != CARGPARSE_NO_SHORT ? short_name : 256 + i;
+            n_long++;
+        }
+    }
+    spec->shortopts[len] = '\0';
+    return cargparse_builder_freeze(&spec->builder, &spec->parser) == CARGPARSE_OK ? 0 : -1;
+}
+
+static void
+_bench_spec_destroy(bench_spec_t *spec) {
+    cargparse_builder_destroy(&spec->builder);
+    free(spec->names);
+    free(spec->longopts);
+}
+
+static char *
+_bench_token(bench_argv_t *args, const char *prefix, const char *name) {
+    char *token = args->strings + (size_t)args->argc * BENCH_TOKEN_LEN;
+
+    sprintf(token, "%s%.*s", prefix, BENCH_TOKEN_LEN - 3, name);
+    args->argv[args->argc++] = token;
+    return token;
+}
+
+/* Each option is given at most once, the tokens left over are positionals */
+static int
+_bench_argv_init(bench_argv_t *args, const bench_spec_t *spec, const bench_mix_e mix, const int tokens) {
+    int i, n_short = 0, n_cluster = 0;
+    char number[BENCH_TOKEN_LEN], *cluster = NULL;
+    const int argc = tokens + 1;
+
+    args->argc = 0;
+    args->argv = malloc(sizeof(char *) * (size_t)(argc + 1));
+    args->scratch = malloc(sizeof(char *) * (size_t)(argc + 1));
+    args->strings = malloc(BENCH_TOKEN_LEN * (size_t)argc);
+    if (!args->argv || !args->scratch || !args->strings) return -1;
+
+    _bench_token(args, "", "bench");
+    if (mix == BENCH_MIX_NUMERIC && argc >= 3) {
+        _bench_token(args, "--", "ints");
+        for (i = 0; args->argc < argc - 1; i++) {
+            sprintf(number, "%d", i);
+            _bench_token(args, "", number);
+        }
+        _bench_token(args, "", "--");
+    }
+    for (i = 1; i < spec->n_options - 1 && args->argc < argc; i++) {
+        if (i % 2 && mix == BENCH_MIX_LONG && args->argc + 2 <= argc) {
+            _bench_token(args, "--", spec->names[i]);
+            _bench_token(args, "", "value");
+        } else if (i % 2 && mix == BENCH_MIX_SHORT && n_short < BENCH_N_SHORT_NAMES &&
+                   args->argc + 2 <= argc) {
+            number[0] = BENCH_SHORT_NAMES[n_short];
+            number[1] = '\0';
+            _bench_token(args, "-", number);
+            _bench_token(args, "", "value");
+        } else if (!(i % 2) && mix == BENCH_MIX_CLUSTER && n_short < BENCH_N_SHORT_NAMES) {
+            if (n_cluster % 4 == 0) cluster = _bench_token(args, "-", "");
+            cluster[1 + n_cluster % 4] = BENCH_SHORT_NAMES[n_short];
+            cluster[2 + n_cluster % 4] = '\0';
+            n_cluster++;
+        }
+        if (n_short < BENCH_N_SHORT_NAMES) n_short++;
+    }
+    while (args->argc < argc) {
+        _bench_token(args, "", "file");
+    }
+    args->argv[args->argc] = NULL;
+    return 0;
+}
+
+static void
+_bench_argv_destroy(bench_argv_t *args) {
+    free(args->argv);
+    free(args->scratch);
+    free(args->strings);
+}
+
+/* Reports the measurement in `counters`, `items` are the tokens, values or options of one op */
+static void
+_bench_report(const char *bench, const char *impl, const bench_spec_t *spec, const int tokens,
+              const char *mix, const int iters, const double items) {
+    const double ns_per_op = counters.ns / iters;
+
+    printf("{\"bench\":\"%s\",\"impl\":\"%s\",\"options\":%d,\"tokens\":%d,\"mix\":\"%s\",\"iterations\":%d,"
+           "\"ns_per_op\":%.1f,\"ns_per_item\":%.2f",
+           bench, impl, spec->n_options, tokens, mix, iters, ns_per_op, items > 0 ? ns_per_op / items : 0.0);
+    if (with_counters) bench_counters_print_json(&counters, stdout, iters, items);
+    printf("}\n");
+    fflush(stdout);
+}
+
+static void
+_bench_prepare(const bench_spec_t *spec) {
+    int i, iters = _bench_iterations(spec->n_options);
+    const unsigned n_words = CARGPARSE_INDEX_SIZE(spec->n_options);
+    unsigned *words = malloc(sizeof(unsigned) * n_words);
+    cargparse_option_hot_t *hot = malloc(sizeof(cargparse_option_hot_t) * spec->n_options);
+    cargparse_t parser = {NULL, NULL, NULL, spec->parser.options, spec->parser.parse_res, spec->n_options,
+                          {NULL, n_words, false, NULL}, NULL, NULL, 0, NULL, NULL, NULL};
+
+    if (!words || !hot) {
+        free(words);
+        free(hot);
+        return;
+    }
+    parser.index.words = words;
+    parser.index.hot = hot;
+    bench_counters_reset(&counters);
+    for (i = 0; i < iters; i++) {
+        parser.index.is_built = false;
+        bench_counters_start(&counters);
+        cargparse_prepare(&parser);
+        bench_counters_stop(&counters);
+    }
+    bench_counters_read(&counters);
+    _bench_report("prepare", "cargparse", spec, 0, "", iters, spec->n_options);
+    free(words);
+    free(hot);
+}
+
+/* print_help writes to stdout, which points at /dev/null meanwhile */
+static void
+_bench_help(const bench_spec_t *spec) {
+    int i, iters = _bench_iterations(16 * spec->n_options), saved_fd, null_fd;
+
+    fflush(stdout);
+    saved_fd = dup(STDOUT_FILENO);
+    null_fd = open("/dev/null", O_WRONLY);
+    if (saved_fd < 0 || null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) return;
+
+    bench_counters_reset(&counters);
+    for (i = 0; i < iters; i++) {
+        bench_counters_start(&counters);
+        cargparse_print_help(&spec->parser);
+        bench_counters_stop(&counters);
+    }
+    bench_counters_read(&counters);
+
+    dup2(saved_fd, STDOUT_FILENO);
+    close(saved_fd);
+    close(null_fd);
+    _bench_report("help", "cargparse", spec, 0, "", iters, spec->n_options);
+}
+
+static int
+_bench_parse(bench_spec_t *spec, const bench_argv_t *args, const char *mix) {
+    int i, iters = _bench_iterations(args->argc - 1 + spec->n_options);
+    cargparse_err_e ret;
+
+    bench_counters_reset(&counters);
+    for (i = 0; i < iters; i++) {
+        memset(spec->parser.parse_res, 0, sizeof(cargparse_parse_res_t) * spec->n_options);
+        bench_counters_start(&counters);
+        ret = cargparse_parse(&spec->parser, args->argc, args->argv);
+        bench_counters_stop(&counters);
+        if (ret != CARGPARSE_OK) {
+            fprintf(stderr, "cargparse_parse: %s\n", cargparse_get_err_msg());
+            return -1;
+        }
+    }
+    bench_counters_read(&counters);
+    _bench_report("parse", "cargparse", spec, args->argc - 1, mix, iters, args->argc - 1);
+    return 0;
+}
+
+/* The same argv fed one token at a time, as an interactive front-end would */
+static int
+_bench_feed(bench_spec_t *spec, const bench_argv_t *args, const char *mix) {
+    int i, j, iters = _bench_iterations(args->argc - 1 + spec->n_options);
+    cargparse_stream_t stream;
+    cargparse_err_e ret = CARGPARSE_OK;
+
+    bench_counters_reset(&counters);
+    for (i = 0; i < iters && ret == CARGPARSE_OK; i++) {
+        memset(spec->parser.parse_res, 0, sizeof(cargparse_parse_res_t) * spec->n_options);
+        bench_counters_start(&counters);
+        cargparse_parse_begin(&stream, &spec->parser);
+        for (j = 2; j <= args->argc; j++) {
+            cargparse_parse_feed(&stream, j, args->argv);
+        }
+        ret = cargparse_parse_finish(&stream);
+        bench_counters_stop(&counters);
+    }
+    if (ret != CARGPARSE_OK) {
+        fprintf(stderr, "cargparse_parse_feed: %s\n", cargparse_get_err_msg());
+        return -1;
+    }
+    bench_counters_read(&counters);
+    _bench_report("parse", "cargparse_feed", spec, args->argc - 1, mix, iters, args->argc - 1);
+    return 0;
+}
+
+/* Parses without checking the numbers, then reads one of them as a tool with sparse access would */
+static int
+_bench_lazy(bench_spec_t *spec, const bench_argv_t *args, const char *mix) {
+    int i, iters = _bench_iterations(args->argc - 1 + spec->n_options);
+    long value;
+    cargparse_lazy_value_t values[BENCH_LAZY_VALUES];
+    cargparse_lazy_t lazy = {NULL, BENCH_LAZY_VALUES, NULL, 0, 0};
+    cargparse_err_e ret = CARGPARSE_OK;
+
+    lazy.values = values;
+    cargparse_set_lazy(&spec->parser, &lazy);
+    bench_counters_reset(&counters);
+    for (i = 0; i < iters && ret == CARGPARSE_OK; i++) {
+        memset(spec->parser.parse_res, 0, sizeof(cargparse_parse_res_t) * spec->n_options);
+        bench_counters_start(&counters);
+        ret = cargparse_parse(&spec->parser, args->argc, args->argv);
+        if (ret == CARGPARSE_OK &&
+            cargparse_get_int_long(&spec->parser, "ints", &value, 0, 0) == CARGPARSE_OK) {
+            sink += value;
+        }
+        bench_counters_stop(&counters);
+    }
+    cargparse_set_lazy(&spec->parser, NULL);
+    if (ret != CARGPARSE_OK) {
+        fprintf(stderr, "cargparse_parse: %s\n", cargparse_get_err_msg());
+        return -1;
+    }
+    bench_counters_read(&counters);
+    _bench_report("parse", "cargparse_lazy", spec, args->argc - 1, mix, iters, args->argc - 1);
+    return 0;
+}
+
+static int
+_bench_getopt(const bench_spec_t *spec, const bench_argv_t *args, const char *mix) {
+    int i, c, idx, iters = _bench_iterations(args->argc - 1 + spec->n_options);
+    long n_opts = 0;
+
+    opterr = 0;
+    bench_counters_reset(&counters);
+    for (i = 0; i < iters; i++) {
+        memcpy(args->scratch, args->argv, sizeof(char *) * (size_t)(args->argc + 1));
+        optind = 0;
+        bench_counters_start(&counters);
+        while ((c = getopt_long(args->argc, args->scratch, spec->shortopts, spec->longopts, &idx)) != -1) {
+            if (c == '?' || c == ':') {
+                bench_counters_stop(&counters);
+                fprintf(stderr, "getopt_long: bad option %s\n", args->scratch[optind - 1]);
+                return -1;
+            }
+            n_opts++;
+        }
+        bench_counters_stop(&counters);
+    }
+    bench_counters_read(&counters);
+    sink += n_opts;
+    _bench_report("parse", "getopt_long", spec, args->argc - 1, mix, iters, args->argc - 1);
+    return 0;
+}
+
+static int
+_bench_getopt_shim(const bench_spec_t *spec, const bench_argv_t *args, const char *mix) {
+    int i, c, idx, iters = _bench_iterations(args->argc - 1 + spec->n_options);
+    long n_opts = 0;
+    cargparse_getopt_spec_t shim;
+    cargparse_getopt_state_t state;
+
+    if (cargparse_getopt_compile(&shim, spec->shortopts, spec->longopts) != CARGPARSE_OK) return -1;
+    bench_counters_reset(&counters);
+    for (i = 0; i < iters; i++) {
+        memcpy(args->scratch, args->argv, sizeof(char *) * (size_t)(args->argc + 1));
+        cargparse_getopt_state_init(&state);
+        state.opterr = 0;
+        bench_counters_start(&counters);
+        while ((c = cargparse_getopt_long(&shim, &state, args->argc, args->scratch, &idx)) != -1) {
+            if (c == '?' || c == ':') {
+                bench_counters_stop(&counters);
+                fprintf(stderr, "cargparse_getopt_long: bad option %s\n", args->scratch[state.optind - 1]);
+                cargparse_getopt_destroy(&shim);
+                return -1;
+            }
+            n_opts++;
+        }
+        bench_counters_stop(&counters);
+    }
+    bench_counters_read(&counters);
+    cargparse_getopt_destroy(&shim);
+    sink += n_opts;
+    _bench_report("parse", "cargparse_getopt", spec, args->argc - 1, mix, iters, args->argc - 1);
+    return 0;
+}
+
+/* Reads back every value of the parse just done, through the getters a program would use */
+static void
+_bench_getters(const bench_spec_t *spec, const bench_argv_t *args, const bench_mix_e mix) {
+    int i, iters;
+    unsigned j, n_gets;
+    long value;
+    bool flag;
+    const char *str;
+    const cargparse_t *parser = &spec->parser;
+
+    if (mix == BENCH_MIX_NUMERIC) {
+        n_gets = (unsigned)parser->parse_res[0].nargs;
+    } else if (mix == BENCH_MIX_POS) {
+        n_gets = (unsigned)parser->parse_res[spec->n_options - 1].nargs;
+    } else {
+        n_gets = (unsigned)spec->n_options - 2;
+    }
+    iters = _bench_iterations((int)n_gets + 1);
+
+    bench_counters_reset(&counters);
+    bench_counters_start(&counters);
+    for (i = 0; i < iters; i++) {
+        for (j = 0; j < n_gets; j++) {
+            if (mix == BENCH_MIX_NUMERIC) {
+                cargparse_get_int_long(parser, "ints", &value, 0, j);
+                sink += value;
+            } else if (mix == BENCH_MIX_POS) {
+                cargparse_get_positional(parser, "files", &str, NULL, j);
+                sink += *str;
+            } else if (j % 2 == 0) {
+                cargparse_get_str_long(parser, spec->names[j + 1], &str, "", 0);
+                sink += *str;
+            } else {
+                cargparse_get_bool_long(parser, spec->names[j + 1], &flag);
+                sink += flag;
+            }
+        }
+    }
+    bench_counters_stop(&counters);
+    bench_counters_read(&counters);
+    _bench_report("get", "cargparse", spec, args->argc - 1, MIX_NAMES[mix], iters, n_gets);
+}
+
+/* A command server's loop: copy a received line, split it in place and parse it into a bound parser */
+static int
+_bench_line(bench_spec_t *spec) {
+    int i, argc, iters, n_words = 1;
+    size_t len = 3;
+    char line[BENCH_LINE_LEN] = "set", buf[BENCH_LINE_LEN], *argv[2 * BENCH_LINE_OPTIONS + 4];
+    cargparse_t conn;
+    cargparse_parse_res_t *parse_res = malloc(sizeof(cargparse_parse_res_t) * spec->n_options);
+    cargparse_err_e ret = CARGPARSE_ERR_NO_MEMORY;
+
+    if (!parse_res || cargparse_bind(&conn, &spec->parser, parse_res) != CARGPARSE_OK) {
+        free(parse_res);
+        return -1;
+    }
+    for (i = 1; i < spec->n_options - 1 && i <= BENCH_LINE_OPTIONS; i++) {
+        len += sprintf(line + len, i % 2 ? " --%s 'value %d'" : " --%s", spec->names[i], i);
+        n_words += i % 2 ? 2 : 1;
+    }
+    strcpy(line + len, " -- \"in file\"\n");
+    n_words += 2;
+    len += strlen(line + len) + 1;
+    iters = _bench_iterations(n_words + spec->n_options);
+
+    bench_counters_reset(&counters);
+    for (i = 0; i < iters; i++) {
+        memset(parse_res, 0, sizeof(cargparse_parse_res_t) * spec->n_options);
+        bench_counters_start(&counters);
+        memcpy(buf, line, len);
+        if ((ret = cargparse_split_line(buf, argv, sizeof(argv) / sizeof(*argv), &argc)) == CARGPARSE_OK) {
+            ret = cargparse_parse(&conn, argc, argv);
+        }
+        bench_counters_stop(&counters);
+        if (ret != CARGPARSE_OK) break;
+    }
+    free(parse_res);
+    if (ret != CARGPARSE_OK) {
+        fprintf(stderr, "cargparse_split_line: %s\n", cargparse_get_err_msg());
+        return -1;
+    }
+    bench_counters_read(&counters);
+    _bench_report("line", "cargparse", spec, n_words - 1, "", iters, n_words - 1);
+    return 0;
+}
+
+/* What a short command line set in a large spec, found through the event log against asking every option */
+static void
+_bench_visit(bench_spec_t *spec) {
+    int i, j, iters = _bench_iterations(spec->n_options);
+    unsigned cursor;
+    bool flag;
+    const char *str;
+    const cargparse_event_t *event;
+    cargparse_event_t events[8];
+    cargparse_event_log_t log = {events, 0, 8};
+    char *argv[] = {"bench", "--opt-1", "value", "--flag-2", "--opt-3", "value", "--", "file"};
+
+    memset(spec->parser.parse_res, 0, sizeof(cargparse_parse_res_t) * spec->n_options);
+    cargparse_set_event_log(&spec->parser, &log);
+    if (cargparse_parse(&spec->parser, sizeof(argv) / sizeof(*argv), argv) != CARGPARSE_OK) {
+        cargparse_set_event_log(&spec->parser, NULL);
+        return;
+    }
+    cargparse_set_event_log(&spec->parser, NULL);
+
+    bench_counters_reset(&counters);
+    bench_counters_start(&counters);
+    for (i = 0; i < iters; i++) {
+        for (cursor = 0; (event = cargparse_event_next(&log, &cursor));) {
+            sink += event->value_idx == -1 ? event->opt_idx : *argv[event->argv_idx];
+        }
+    }
+    bench_counters_stop(&counters);
+    bench_counters_read(&counters);
+    _bench_report("visit", "events", spec, 7, "", iters, log.n_events);
+
+    bench_counters_reset(&counters);
+    bench_counters_start(&counters);
+    for (i = 0; i < iters; i++) {
+        for (j = 1; j < spec->n_options - 1; j++) {
+            if (j % 2) {
+                if (cargparse_get_str_long(&spec->parser, spec->names[j], &str, NULL, 0) == CARGPARSE_OK) {
+                    sink += *str;
+                }
+            } else {
+                cargparse_get_bool_long(&spec->parser, spec->names[j], &flag);
+                sink += flag;
+            }
+        }
+    }
+    bench_counters_stop(&counters);
+    bench_counters_read(&counters);
+    _bench_report("visit", "getters", spec, 7, "", iters, log.n_events);
+}
+
+static void
+_bench_complete(const bench_spec_t *spec) {
+    int i;
+    char buf[1 << 16], prefix[] = "--opt-1";
+    char *argv[] = {"bench", prefix};
+    cargparse_argv_buf_t out;
+
+    out.buf = buf;
+    out.buf_size = sizeof(buf);
+    bench_counters_reset(&counters);
+    bench_counters_start(&counters);
+    for (i = 0; i < BENCH_COMPLETE_QUERIES; i++) {
+        cargparse_complete(&spec->parser, 2, argv, 1, &out);
+        sink += out.argc;
+    }
+    bench_counters_stop(&counters);
+    bench_counters_read(&counters);
+    _bench_report("complete", "cargparse", spec, 1, prefix, BENCH_COMPLETE_QUERIES, out.argc);
+}
+
+int
+main(int argc, char **argv) {
+    int s, t, m, ret = 0;
+    long max_options, max_tokens;
+    bool help;
+    const char *only_mix;
+    bench_spec_t spec;
+    bench_argv_t args;
+
+    /* clang-format off */
+    CARGPARSE_INIT(bench_args, "cargparse_bench [OPTION]...", "Prints one JSON result per line.", NULL,
+        CARGPARSE_OPTION_INT(CARGPARSE_NO_SHORT, "max-options", "largest spec (10000)", CARGPARSE_FLAG_NONE,
+                             1),
+        CARGPARSE_OPTION_INT(CARGPARSE_NO_SHORT, "max-tokens", "longest argv (1000000)", CARGPARSE_FLAG_NONE,
+                             1),
+        CARGPARSE_OPTION_STRING(CARGPARSE_NO_SHORT, "mix", "only this token mix", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_BOOL(CARGPARSE_NO_SHORT, "counters", "read hardware counters", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_BOOL('h', "help", "print this help", CARGPARSE_FLAG_NONE),
+    );
+    /* clang-format on */
+
+    ret = cargparse_parse(&bench_args, argc, argv);
+    if (ret != CARGPARSE_OK && ret != CARGPARSE_GOT_ZERO_ARGS) {
+        fprintf(stderr, "%s\n", cargparse_get_err_msg());
+        return 2;
+    }
+    cargparse_get_bool_long(&bench_args, "help", &help);
+    if (help) {
+        cargparse_print_help(&bench_args);
+        return 0;
+    }
+    cargparse_get_int_long(&bench_args, "max-options", &max_options, 10000, 0);
+    cargparse_get_int_long(&bench_args, "max-tokens", &max_tokens, 1000000, 0);
+    cargparse_get_str_long(&bench_args, "mix", &only_mix, NULL, 0);
+    cargparse_get_bool_long(&bench_args, "counters", &with_counters);
+    if (bench_counters_open(&counters, with_counters) == 0 && with_counters) {
+        fprintf(stderr, "hardware counters unavailable, reporting clock timings only\n");
+    }
+    ret = 0;
+
+    for (s = 0; s < (int)(sizeof(SPEC_SIZES) / sizeof(int)) && SPEC_SIZES[s] <= max_options; s++) {
+        if (_bench_spec_init(&spec, SPEC_SIZES[s]) != 0) {
+            fprintf(stderr, "cannot build a spec of %d options\n", SPEC_SIZES[s]);
+            return 1;
+        }
+        _bench_prepare(&spec);
+        _bench_help(&spec);
+        _bench_complete(&spec);
+        if (_bench_line(&spec) != 0) ret = 1;
+        _bench_visit(&spec);
+        for (t = 0; t < (int)(sizeof(TOKEN_COUNTS) / sizeof(int)) && TOKEN_COUNTS[t] <= max_tokens; t++) {
+            for (m = 0; m < BENCH_N_MIXES; m++) {
+                if (only_mix && strcmp(only_mix, MIX_NAMES[m]) != 0) continue;
+                if (_bench_argv_init(&args, &spec, (bench_mix_e)m, TOKEN_COUNTS[t]) != 0) {
+                    fprintf(stderr, "cannot allocate %d tokens\n", TOKEN_COUNTS[t]);
+                    return 1;
+                }
+                if (_bench_getopt(&spec, &args, MIX_NAMES[m]) != 0 ||
+                    _bench_getopt_shim(&spec, &args, MIX_NAMES[m]) != 0 ||
+                    _bench_feed(&spec, &args, MIX_NAMES[m]) != 0 ||
+                    _bench_parse(&spec, &args, MIX_NAMES[m]) != 0 ||
+                    (m == BENCH_MIX_NUMERIC && _bench_lazy(&spec, &args, MIX_NAMES[m]) != 0)) {
+                    ret = 1;
+                } else {
+                    _bench_getters(&spec, &args, (bench_mix_e)m);
+                }
+                _bench_argv_destroy(&args);
+            }
+        }
+        _bench_spec_destroy(&spec);
+    }
+    bench_counters_close(&counters);
+    return ret;
+}
@@ -0,0 +1,140 @@
+#define _DEFAULT_SOURCE
+
+#include "counters.h"
+
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *const COUNTER_NAMES[] = {"instructions", "cycles",     "branches",
+                                            "branch_misses", "l1d_misses", "llc_misses"};
+
+static void
+_bench_counter_attr(struct perf_event_attr *attr, const bench_counter_e counter) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->type = PERF_TYPE_HARDWARE;
+    attr->disabled = 1;
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (counter) {
+        case BENCH_COUNTER_INSTRUCTIONS:
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case BENCH_COUNTER_CYCLES:
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case BENCH_COUNTER_BRANCHES:
+            attr->config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS;
+            break;
+        case BENCH_COUNTER_BRANCH_MISSES:
+            attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case BENCH_COUNTER_L1D_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default:
+            attr->config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+    }
+}
+
+double
+bench_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int
+bench_counters_open(bench_counters_t *self, const int enabled) {
+    int i, n_open = 0;
+    struct perf_event_attr attr;
+
+    memset(self, 0, sizeof(*self));
+    for (i = 0; i < BENCH_N_COUNTERS; i++) {
+        self->fds[i] = -1;
+        if (!enabled) continue;
+        _bench_counter_attr(&attr, (bench_counter_e)i);
+        self->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (self->fds[i] >= 0) n_open++;
+    }
+    return n_open;
+}
+
+void
+bench_counters_close(bench_counters_t *self) {
+    int i;
+
+    for (i = 0; i < BENCH_N_COUNTERS; i++) {
+        if (self->fds[i] >= 0) close(self->fds[i]);
+        self->fds[i] = -1;
+    }
+}
+
+void
+bench_counters_reset(bench_counters_t *self) {
+    int i;
+
+    for (i = 0; i < BENCH_N_COUNTERS; i++) {
+        if (self->fds[i] >= 0) ioctl(self->fds[i], PERF_EVENT_IOC_RESET, 0);
+        self->values[i] = 0;
+    }
+    self->ns = 0.0;
+}
+
+void
+bench_counters_start(bench_counters_t *self) {
+    int i;
+
+    for (i = 0; i < BENCH_N_COUNTERS; i++) {
+        if (self->fds[i] >= 0) ioctl(self->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    self->start_ns = bench_now_ns();
+}
+
+void
+bench_counters_stop(bench_counters_t *self) {
+    int i;
+
+    self->ns += bench_now_ns() - self->start_ns;
+    for (i = 0; i < BENCH_N_COUNTERS; i++) {
+        if (self->fds[i] >= 0) ioctl(self->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+void
+bench_counters_read(bench_counters_t *self) {
+    int i;
+    unsigned long long data[3]; /* value, time enabled, time running */
+
+    for (i = 0; i < BENCH_N_COUNTERS; i++) {
+        if (self->fds[i] < 0 || read(self->fds[i], data, sizeof(data)) != (ssize_t)sizeof(data)) continue;
+        /* scaled up when the PMU was shared with other events */
+        self->values[i] = data[2] > 0 && data[2] < data[1]
+                              ? (unsigned long long)((double)data[0] * (double)data[1] / (double)data[2])
+                              : data[0];
+    }
+}
+
+void
+bench_counters_print_json(const bench_counters_t *self, FILE *out, const double ops, const double items) {
+    int i;
+
+    for (i = 0; i < BENCH_N_COUNTERS; i++) {
+        if (self->fds[i] < 0) {
+            fprintf(out, ",\"%s\":null,\"%s_per_item\":null", COUNTER_NAMES[i], COUNTER_NAMES[i]);
+            continue;
+        }
+        fprintf(out, ",\"%s\":%.1f,\"%s_per_item\":%.2f", COUNTER_NAMES[i], (double)self->values[i] / ops,
+                COUNTER_NAMES[i], items > 0 ? (double)self->values[i] / ops / items : 0.0);
+    }
+}
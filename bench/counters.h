@@ -0,0 +1,56 @@
+#ifndef CARGPARSE_BENCH_COUNTERS_H
+#define CARGPARSE_BENCH_COUNTERS_H
+
+#include <stdio.h>
+
+typedef enum {
+    BENCH_COUNTER_INSTRUCTIONS = 0,
+    BENCH_COUNTER_CYCLES,
+    BENCH_COUNTER_BRANCHES,
+    BENCH_COUNTER_BRANCH_MISSES,
+    BENCH_COUNTER_L1D_MISSES,
+    BENCH_COUNTER_LLC_MISSES,
+    BENCH_N_COUNTERS,
+} bench_counter_e;
+
+/* User-space perf_event_open counters around measured regions, plus the wall clock. Counters the kernel or
+ * the machine does not provide (VMs, perf_event_paranoid) stay closed and read as unavailable, so a region
+ * always has at least its clock time. */
+typedef struct {
+    int fds[BENCH_N_COUNTERS]; /* -1 when unavailable */
+    unsigned long long values[BENCH_N_COUNTERS];
+    double ns;
+    double start_ns;
+} bench_counters_t;
+
+/* Returns the number of counters opened, `enabled` false opens none */
+int
+bench_counters_open(bench_counters_t *self, const int enabled);
+
+void
+bench_counters_close(bench_counters_t *self);
+
+/* Zeroes the counts and the clock before a measurement */
+void
+bench_counters_reset(bench_counters_t *self);
+
+/* start/stop pairs accumulate into one measurement */
+void
+bench_counters_start(bench_counters_t *self);
+
+void
+bench_counters_stop(bench_counters_t *self);
+
+/* Reads the counts accumulated since bench_counters_reset */
+void
+bench_counters_read(bench_counters_t *self);
+
+/* `,"<counter>":<count per op>,"<counter>_per_item":<count per item>` for every counter, null when
+ * unavailable */
+void
+bench_counters_print_json(const bench_counters_t *self, FILE *out, const double ops, const double items);
+
+double
+bench_now_ns(void);
+
+#endif
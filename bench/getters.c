@@ -0,0 +1,88 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+
+#ifdef BENCH_SINGLE_HEADER
+#define CARGPARSE_STATIC
+#include "cargparse_single.h"
+#else
+#include "cargparse.h"
+#endif
+#include "counters.h"
+
+/* Getter-heavy loop over constant option names, built three ways by bench/Makefile: linked against
+ * libcargparse.a ("lib"), with cargparse.c in the same link-time optimized program ("lto"), and from
+ * cargparse_single.h with CARGPARSE_STATIC ("single"). Prints one JSON line like cargparse_bench. */
+
+#ifndef BENCH_IMPL
+#define BENCH_IMPL "lib"
+#endif
+
+#define BENCH_ROUNDS 1000000
+#define BENCH_GETS_PER_ROUND 8
+
+int
+main(void) {
+    int i;
+    bool verbose, quiet;
+    long level, threads, sum = 0;
+    double ratio, start;
+    const char *name, *mode, *file;
+    char *argv[] = {"bench", "--level", "3", "--ratio", "0.5", "--name", "x",        "-v",
+                    "-t",    "8",       "--mode", "fast", "--",    "file", NULL};
+
+    /* clang-format off */
+    CARGPARSE_INIT(parser, NULL, NULL, NULL,
+        CARGPARSE_OPTION_INT('l', "level", "compaction level", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_FLOAT('r', "ratio", "size ratio", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_STRING('n', "name", "name", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_BOOL('q', "quiet", "no output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_INT('t', "threads", "worker threads", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_STRING('m', "mode", "mode", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_STRING(CARGPARSE_NO_SHORT, "codec", "codec", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_INT(CARGPARSE_NO_SHORT, "block-size", "block size", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_BOOL(CARGPARSE_NO_SHORT, "dry-run", "change nothing", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_POSITIONAL("file", "input file", CARGPARSE_FLAG_NONE, 1),
+    );
+    /* clang-format on */
+
+    if (cargparse_parse(&parser, sizeof(argv) / sizeof(*argv) - 1, argv) != CARGPARSE_OK) {
+        fprintf(stderr, "cargparse_parse: %s\n", cargparse_get_err_msg());
+        return 1;
+    }
+
+    /* a misspelled name fails here instead of summing stale values, -q is not given */
+    if (cargparse_get_int_long(&parser, "level", &level, 0, 0) != CARGPARSE_OK ||
+        cargparse_get_float_long(&parser, "ratio", &ratio, 1.0, 0) != CARGPARSE_OK ||
+        cargparse_get_str_long(&parser, "name", &name, "", 0) != CARGPARSE_OK ||
+        cargparse_get_bool_long(&parser, "verbose", &verbose) != CARGPARSE_OK ||
+        cargparse_get_bool_short(&parser, 'q', &quiet) != CARGPARSE_DEFAULT_VALUE ||
+        cargparse_get_int_short(&parser, 't', &threads, 1, 0) != CARGPARSE_OK ||
+        cargparse_get_str_long(&parser, "mode", &mode, "", 0) != CARGPARSE_OK ||
+        cargparse_get_positional(&parser, "file", &file, "", 0) != CARGPARSE_OK) {
+        fprintf(stderr, "getter: %s\n", cargparse_get_err_msg());
+        return 1;
+    }
+
+    start = bench_now_ns();
+    for (i = 0; i < BENCH_ROUNDS; i++) {
+        /* the parse results may change between rounds, nothing is hoisted out of the loop */
+        __asm__ __volatile__("" ::: "memory");
+        cargparse_get_int_long(&parser, "level", &level, 0, 0);
+        cargparse_get_float_long(&parser, "ratio", &ratio, 1.0, 0);
+        cargparse_get_str_long(&parser, "name", &name, "", 0);
+        cargparse_get_bool_long(&parser, "verbose", &verbose);
+        cargparse_get_bool_short(&parser, 'q', &quiet);
+        cargparse_get_int_short(&parser, 't', &threads, 1, 0);
+        cargparse_get_str_long(&parser, "mode", &mode, "", 0);
+        cargparse_get_positional(&parser, "file", &file, "", 0);
+        sum += level + threads + (long)(ratio * 2) + verbose + quiet + name[0] + mode[0] + file[0];
+    }
+
+    printf("{\"bench\":\"get_inline\",\"impl\":\"%s\",\"options\":%d,\"gets\":%d,\"ns_per_get\":%.2f,"
+           "\"check\":%ld}\n",
+           BENCH_IMPL, parser.n_options, BENCH_ROUNDS * BENCH_GETS_PER_ROUND,
+           (bench_now_ns() - start) / ((double)BENCH_ROUNDS * BENCH_GETS_PER_ROUND), sum);
+    return 0;
+}
@@ -1,13 +1,43 @@
+#define _DEFAULT_SOURCE
+
 #include "cargparse.h"
 
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef CARGPARSE_TRACE
+#include <time.h>
+#endif
+
+/* Lookup and getter helpers, forced inline into the public getters by the single-header CARGPARSE_STATIC
+ * build (see tools/amalgamate.sh) so constant option names and types fold into each call */
+#ifdef CARGPARSE_STATIC
+#define CARGPARSE_INLINE static __inline__ __attribute__((always_inline))
+#else
+#define CARGPARSE_INLINE static
+#endif
 
 #define CARGPARSE_MAX_ERR_MSG_LEN 256
+#define CARGPARSE_MAX_NAME_LEN 128
+
+/* The error message is kept per thread, parsers bound to one spec parse from several threads at once */
+#ifdef __GNUC__
+#define CARGPARSE_THREAD_LOCAL __thread
+#else
+#define CARGPARSE_THREAD_LOCAL
+#endif
 
-static char err_msg_buf[CARGPARSE_MAX_ERR_MSG_LEN] = {0};
+extern char **environ;
+
+static CARGPARSE_THREAD_LOCAL char err_msg_buf[CARGPARSE_MAX_ERR_MSG_LEN] = {0};
 
 typedef enum {
     CARGPARSE_ARG_INCORRECT = -1,
@@ -17,6 +47,34 @@ typedef enum {
     CARGPARSE_ARG_DOUBLE_HYPHEN,
 } cargparse_arg_type_e;
 
+#define CARGPARSE_N_ARG_TYPES 5 /* columns of the parse table, cargparse_arg_type_e + 1 */
+
+/* What the parse loop waits for between tokens */
+typedef enum {
+    CARGPARSE_STATE_NONE = 0,   /* an option or a positional */
+    CARGPARSE_STATE_NEEDS_ARG,  /* the rest of the values of a fixed nargs option */
+    CARGPARSE_STATE_VARIADIC,   /* values of a variadic option until the next option or "--" */
+    CARGPARSE_STATE_POSITIONAL, /* only positionals, after "--" */
+    CARGPARSE_N_STATES,
+} cargparse_parse_state_e;
+
+typedef enum {
+    CARGPARSE_ACTION_SKIP = 0,
+    CARGPARSE_ACTION_POSITIONAL,
+    CARGPARSE_ACTION_VALUE,
+    CARGPARSE_ACTION_SHORT,
+    CARGPARSE_ACTION_LONG,
+    CARGPARSE_ACTION_DOUBLE_HYPHEN,
+    CARGPARSE_ACTION_ERR_PENDING,    /* an option while the previous one still needs values */
+    CARGPARSE_ACTION_ERR_PENDING_DH, /* "--" while the previous option still needs values */
+} cargparse_parse_action_e;
+
+/* Forgets the message of an earlier call, so each parse or split reports its own first error */
+static void
+_cargparse_clear_err_msg(void) {
+    err_msg_buf[0] = '\0';
+}
+
 static void
 _cargparse_set_err_msg(const char *msg, const char *arg) {
     size_t msg_len, arg_len, available;
@@ -54,68 +112,512 @@ cargparse_get_err_msg(void) {
     return err_msg_buf;
 }
 
+/* Hook and counter sites expand to nothing without CARGPARSE_TRACE */
+#ifdef CARGPARSE_TRACE
+#define CARGPARSE_TRACE_EVENT(_self, _event, _opt_idx, _arg, _detail) \
+    _cargparse_trace_event(_self, _event, _opt_idx, _arg, _detail)
+#define CARGPARSE_TRACE_COUNT(_self, _counter) ((_self)->trace ? (void)(_self)->trace->_counter++ : (void)0)
+#define CARGPARSE_TRACE_PHASE(_self, _phase) _cargparse_trace_phase(_self, _phase)
+
+static unsigned long long
+_cargparse_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/* Adds the time of the running phase and starts `phase`, -1 starts none */
 static void
-_cargparse_print_option(const cargparse_option_t *opt) {
-    const char *OPT_TYPE_STR[] = {"POS", "BOOL", "INT", "FLOAT", "STR"};
+_cargparse_trace_phase(const cargparse_t *const self, const int phase) {
+    unsigned long long now;
+    cargparse_trace_t *trace = self->trace;
+
+    if (!trace) return;
+    now = _cargparse_now_ns();
+    if (trace->phase >= 0) trace->ns[trace->phase] += now - trace->phase_start;
+    trace->phase = phase;
+    trace->phase_start = now;
+}
 
-    printf("  %5s  ", OPT_TYPE_STR[opt->type]);
+static void
+_cargparse_trace_event(const cargparse_t *const self, const cargparse_trace_event_e event, const int opt_idx,
+                       const char *arg, const int detail) {
+    cargparse_trace_t *trace = self->trace;
+
+    if (!trace) return;
+    switch (event) {
+        case CARGPARSE_TRACE_TOKEN:
+            trace->tokens++;
+            break;
+        case CARGPARSE_TRACE_CONVERT:
+            trace->conversions++;
+            break;
+        case CARGPARSE_TRACE_ERROR:
+            trace->errors++;
+            break;
+        case CARGPARSE_TRACE_MATCH:
+            break;
+    }
+    if (trace->hook) trace->hook(self, event, opt_idx, arg, detail, trace->ctx);
+}
 
-    if (opt->type == CARGPARSE_OPTION_TYPE_POS || opt->short_name == -1) {
-        printf("    ");
-    } else {
-        printf("-%c  ", opt->short_name);
+/* Ends a traced call: stops its phase and reports `ret` when it is an error */
+static cargparse_err_e
+_cargparse_trace_return(const cargparse_t *const self, const cargparse_err_e ret) {
+    if (!self || !self->trace) return ret;
+    _cargparse_trace_phase(self, -1);
+    if (ret >= CARGPARSE_ERR_NULL_PARSER && ret != CARGPARSE_ZERO_NARGS && ret != CARGPARSE_OPT_NOT_GOT &&
+        ret != CARGPARSE_MAP_KEY_NOT_FOUND) {
+        _cargparse_trace_event(self, CARGPARSE_TRACE_ERROR, -1, NULL, (int)ret);
     }
+    return ret;
+}
 
-    if (opt->type == CARGPARSE_OPTION_TYPE_POS || !opt->long_name) {
-        printf("%17s  ", "");
-    } else {
-        printf("--%-15s  ", opt->long_name);
+void
+cargparse_set_trace(cargparse_t *const self, cargparse_trace_t *const trace, const cargparse_trace_f hook,
+                    void *ctx) {
+    if (!self) return;
+    if (trace) {
+        memset(trace, 0, sizeof(*trace));
+        trace->hook = hook;
+        trace->ctx = ctx;
+        trace->phase = -1;
     }
+    self->trace = trace;
+}
+#else
+#define CARGPARSE_TRACE_EVENT(_self, _event, _opt_idx, _arg, _detail) ((void)0)
+#define CARGPARSE_TRACE_COUNT(_self, _counter) ((void)0)
+#define CARGPARSE_TRACE_PHASE(_self, _phase) ((void)0)
+#endif
+
+#define CARGPARSE_HELP_WIDTH 80
+#define CARGPARSE_HELP_MIN_TEXT_WIDTH 24
+#define CARGPARSE_HELP_STACK_SIZE 4096
+
+typedef struct {
+    char *buf; /* NULL while measuring */
+    size_t buf_size;
+    size_t size;
+} _cargparse_help_state_t;
 
-    printf("%s\n", opt->help ? opt->help : "");
+static void
+_cargparse_help_put(_cargparse_help_state_t *state, const char *str, const size_t len) {
+    if (state->buf && state->size + len <= state->buf_size) memcpy(state->buf + state->size, str, len);
+    state->size += len;
 }
 
-void
-cargparse_print_help(const cargparse_t *const self) {
+static void
+_cargparse_help_pad(_cargparse_help_state_t *state, const size_t n) {
+    if (state->buf && state->size + n <= state->buf_size) memset(state->buf + state->size, ' ', n);
+    state->size += n;
+}
+
+/* Word-wraps `text` at `text_width` columns, continuation lines are indented by `indent`. Newlines in the
+ * text are kept, a word longer than the line is not split. */
+static void
+_cargparse_help_wrap(_cargparse_help_state_t *state, const char *text, const size_t indent,
+                     const size_t text_width) {
+    size_t col = 0, spaces, len;
+    bool is_fresh_line = false;
+    const char *word, *end;
+
+    while (*text != '\0') {
+        if (*text == '\n') {
+            _cargparse_help_put(state, "\n", 1);
+            is_fresh_line = true;
+            col = 0;
+            text++;
+            continue;
+        }
+        for (word = text; *word == ' '; word++) {
+        }
+        for (end = word; *end != '\0' && *end != ' ' && *end != '\n'; end++) {
+        }
+        spaces = (size_t)(word - text);
+        len = (size_t)(end - word);
+        text = end;
+        if (len == 0) continue;
+
+        if (col > 0 && col + spaces + len > text_width) {
+            _cargparse_help_put(state, "\n", 1);
+            is_fresh_line = true;
+            col = 0;
+            spaces = 0;
+        }
+        if (is_fresh_line) {
+            _cargparse_help_pad(state, indent);
+            is_fresh_line = false;
+        }
+        _cargparse_help_pad(state, spaces);
+        _cargparse_help_put(state, word, len);
+        col += spaces + len;
+    }
+}
+
+static void
+_cargparse_help_all(const cargparse_t *const self, const size_t width, _cargparse_help_state_t *state) {
+    static const char *const OPT_TYPE_STR[] = {"POS", "BOOL", "INT", "FLOAT", "STR", "MAP"};
     int i;
-    const char *ch_ptr_start, *ch_ptr_end;
+    size_t len, long_width = 0, indent, text_width;
+    const char *start, *end;
+    const cargparse_option_t *opt;
 
     if (self->usages) {
-        ch_ptr_start = self->usages;
-        ch_ptr_end = strchr(ch_ptr_start, '\n');
-        if (ch_ptr_end) {
-            printf("Usages: %.*s\n", (int)(ch_ptr_end - ch_ptr_start), ch_ptr_start);
-            ch_ptr_start = ch_ptr_end + 1;
-            while ((ch_ptr_end = strchr(ch_ptr_start, '\n'))) {
-                printf("        %.*s\n", (int)(ch_ptr_end - ch_ptr_start), ch_ptr_start);
-                ch_ptr_start = ch_ptr_end + 1;
-            }
-            if (*ch_ptr_start != '\0') {
-                printf("        %s\n", ch_ptr_start);
-            }
-        } else {
-            printf("Usages: %s\n", ch_ptr_start);
+        for (start = self->usages, i = 0;; start = end + 1, i++) {
+            end = strchr(start, '\n');
+            len = end ? (size_t)(end - start) : strlen(start);
+            if (!end && len == 0 && i > 0) break;
+            _cargparse_help_put(state, i == 0 ? "Usages: " : "        ", 8);
+            _cargparse_help_put(state, start, len);
+            _cargparse_help_put(state, "\n", 1);
+            if (!end) break;
         }
-        printf("\n");
+        _cargparse_help_put(state, "\n", 1);
     }
     if (self->description) {
-        printf("%s\n", self->description);
-        printf("\n");
+        _cargparse_help_wrap(state, self->description, 0, width);
+        _cargparse_help_put(state, "\n\n", 2);
     }
     if (self->n_options > 0) {
         for (i = 0; i < self->n_options; i++) {
-            _cargparse_print_option(&self->options[i]);
+            opt = &self->options[i];
+            if (opt->type != CARGPARSE_OPTION_TYPE_POS && opt->long_name) {
+                len = strlen(opt->long_name) + 2;
+                if (len > long_width) long_width = len;
+            }
+        }
+        /* "  TYPE  -s  --long-name  help" */
+        indent = 13 + (long_width > 0 ? long_width + 2 : 0);
+        text_width = CARGPARSE_HELP_MIN_TEXT_WIDTH;
+        if (width > indent + text_width) text_width = width - indent;
+        for (i = 0; i < self->n_options; i++) {
+            opt = &self->options[i];
+            len = strlen(OPT_TYPE_STR[opt->type]);
+            _cargparse_help_pad(state, 7 - len);
+            _cargparse_help_put(state, OPT_TYPE_STR[opt->type], len);
+            _cargparse_help_pad(state, 2);
+            if (opt->type == CARGPARSE_OPTION_TYPE_POS || opt->short_name == CARGPARSE_NO_SHORT) {
+                _cargparse_help_pad(state, 4);
+            } else {
+                _cargparse_help_put(state, "-", 1);
+                _cargparse_help_put(state, &opt->short_name, 1);
+                _cargparse_help_pad(state, 2);
+            }
+            if (long_width > 0) {
+                len = 0;
+                if (opt->type != CARGPARSE_OPTION_TYPE_POS && opt->long_name) {
+                    len = strlen(opt->long_name);
+                    _cargparse_help_put(state, "--", 2);
+                    _cargparse_help_put(state, opt->long_name, len);
+                    len += 2;
+                }
+                _cargparse_help_pad(state, long_width - len + 2);
+            }
+            _cargparse_help_wrap(state, opt->help ? opt->help : "", indent, text_width);
+            _cargparse_help_put(state, "\n", 1);
         }
-        printf("\n");
+        _cargparse_help_put(state, "\n", 1);
     }
     if (self->epilog) {
-        printf("%s\n", self->epilog);
+        _cargparse_help_wrap(state, self->epilog, 0, width);
+        _cargparse_help_put(state, "\n", 1);
     }
 }
 
-static int
+cargparse_err_e
+cargparse_render_help(const cargparse_t *const self, const unsigned width, char *buf, const size_t buf_size,
+                      size_t *help_size) {
+    _cargparse_help_state_t state;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!help_size) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    state.buf = buf;
+    state.buf_size = buf_size;
+    state.size = 0;
+    _cargparse_help_all(self, width > 0 ? width : CARGPARSE_HELP_WIDTH, &state);
+    *help_size = state.size + 1;
+    if (!buf || buf_size < *help_size) return CARGPARSE_ERR_BUFFER_TOO_SMALL;
+
+    buf[state.size] = '\0';
+    return CARGPARSE_OK;
+}
+
+static unsigned
+_cargparse_terminal_width(void) {
+    long columns;
+    struct winsize ws;
+    const char *env = getenv("COLUMNS");
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) return ws.ws_col;
+    if (env && (columns = strtol(env, NULL, 10)) > 0 && columns < 0x10000) return (unsigned)columns;
+    return CARGPARSE_HELP_WIDTH;
+}
+
+void
+cargparse_print_help(const cargparse_t *const self) {
+    char stack_buf[CARGPARSE_HELP_STACK_SIZE], *buf = stack_buf;
+    unsigned width = _cargparse_terminal_width();
+    size_t size = 0, written = 0;
+    ssize_t n;
+    cargparse_err_e ret;
+
+    ret = cargparse_render_help(self, width, buf, sizeof(stack_buf), &size);
+    if (ret == CARGPARSE_ERR_BUFFER_TOO_SMALL) {
+        buf = malloc(size);
+        if (!buf) return;
+        ret = cargparse_render_help(self, width, buf, size, &size);
+    }
+
+    /* one write for the whole text, after anything still buffered by stdio */
+    fflush(stdout);
+    while (ret == CARGPARSE_OK && written + 1 < size) {
+        n = write(STDOUT_FILENO, buf + written, size - 1 - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        written += (size_t)n;
+    }
+    if (buf != stack_buf) free(buf);
+}
+
+#define CARGPARSE_HASH_BASIS 2166136261U
+
+/* FNV-1a, continued from `hash` */
+CARGPARSE_INLINE unsigned
+_cargparse_hash_update(unsigned hash, const char *str, const size_t len) {
+    size_t i;
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+CARGPARSE_INLINE unsigned
+_cargparse_hash(const char *str, const size_t len) {
+    return _cargparse_hash_update(CARGPARSE_HASH_BASIS, str, len);
+}
+
+#define CARGPARSE_HOT_MAX_NAME_LEN 255
+
+CARGPARSE_INLINE unsigned char
+_cargparse_hot_name_len(const size_t len) {
+    return len < CARGPARSE_HOT_MAX_NAME_LEN ? (unsigned char)len : CARGPARSE_HOT_MAX_NAME_LEN;
+}
+
+/* Adds option `i` to index words and fills its packed record when `hot` is given, the first option with
+ * a given name wins as with a linear search */
+static void
+_cargparse_index_insert(unsigned *words, const unsigned n_words, cargparse_option_hot_t *hot,
+                        const cargparse_option_t *options, const int i) {
+    unsigned hash = 0, slot, n_long_slots = n_words - CARGPARSE_INDEX_SHORT_SLOTS;
+    unsigned *short_slots = words, *long_slots = words + CARGPARSE_INDEX_SHORT_SLOTS;
+    size_t len = 0;
+    const cargparse_option_t *opt = &options[i];
+
+    if (opt->long_name != CARGPARSE_NO_LONG) {
+        len = strlen(opt->long_name);
+        hash = _cargparse_hash(opt->long_name, len);
+    }
+    if (hot) {
+        hot[i].hash = hash;
+        hot[i].nargs = opt->nargs;
+        hot[i].flags = (unsigned short)opt->flags;
+        hot[i].type = (unsigned char)opt->type;
+        hot[i].name_len = _cargparse_hot_name_len(len);
+    }
+
+    if (opt->short_name > 0 && (unsigned char)opt->short_name < CARGPARSE_INDEX_SHORT_SLOTS &&
+        short_slots[(int)opt->short_name] == 0) {
+        short_slots[(int)opt->short_name] = i + 1;
+    }
+    if (opt->long_name == CARGPARSE_NO_LONG) return;
+
+    slot = hash % n_long_slots;
+    while (long_slots[slot] != 0 && strcmp(options[long_slots[slot] - 1].long_name, opt->long_name) != 0) {
+        slot = (slot + 1) % n_long_slots;
+    }
+    if (long_slots[slot] == 0) {
+        long_slots[slot] = i + 1;
+    }
+}
+
+void
+cargparse_prepare(cargparse_t *const self) {
+    int i;
+
+    if (!self || self->index.is_built || !self->index.words ||
+        self->index.n_words < (unsigned)CARGPARSE_INDEX_SIZE(self->n_options)) {
+        return;
+    }
+
+    memset(self->index.words, 0, sizeof(unsigned) * self->index.n_words);
+    for (i = 0; i < self->n_options; i++) {
+        _cargparse_index_insert(self->index.words, self->index.n_words, self->index.hot, self->options, i);
+    }
+    self->index.is_built = true;
+}
+
+#define CARGPARSE_BUILDER_MIN_OPTIONS 8
+
+void
+cargparse_builder_init(cargparse_builder_t *const self, const char *usages, const char *description,
+                       const char *epilog) {
+    if (!self) return;
+    memset(self, 0, sizeof(*self));
+    self->usages = usages;
+    self->description = description;
+    self->epilog = epilog;
+}
+
+/* Doubles the capacity, rehashing is amortized over the adds that filled it */
+static cargparse_err_e
+_cargparse_builder_grow(cargparse_builder_t *const self) {
+    int i, max_options = self->max_options ? 2 * self->max_options : CARGPARSE_BUILDER_MIN_OPTIONS;
+    unsigned n_words = CARGPARSE_INDEX_SIZE(max_options), *words;
+    cargparse_option_t *options;
+    cargparse_option_hot_t *hot;
+
+    if (!(options = realloc(self->options, sizeof(cargparse_option_t) * max_options))) {
+        _cargparse_set_err_msg("Out of memory", NULL);
+        return CARGPARSE_ERR_NO_MEMORY;
+    }
+    self->options = options;
+    if (!(hot = realloc(self->hot, sizeof(cargparse_option_hot_t) * max_options))) {
+        _cargparse_set_err_msg("Out of memory", NULL);
+        return CARGPARSE_ERR_NO_MEMORY;
+    }
+    self->hot = hot;
+    if (!(words = calloc(n_words, sizeof(unsigned)))) {
+        _cargparse_set_err_msg("Out of memory", NULL);
+        return CARGPARSE_ERR_NO_MEMORY;
+    }
+    for (i = 0; i < self->n_options; i++) {
+        _cargparse_index_insert(words, n_words, NULL, options, i);
+    }
+    free(self->words);
+    self->words = words;
+    self->n_words = n_words;
+    self->max_options = max_options;
+    return CARGPARSE_OK;
+}
+
+/* Short names outside the ASCII table are not indexed and not checked, as with static parsers */
+static bool
+_cargparse_builder_has_name(const cargparse_builder_t *const self, const cargparse_option_t *const opt) {
+    unsigned slot, n_long_slots = self->n_words - CARGPARSE_INDEX_SHORT_SLOTS;
+    const unsigned *long_slots = self->words + CARGPARSE_INDEX_SHORT_SLOTS;
+
+    if (opt->short_name > 0 && (unsigned char)opt->short_name < CARGPARSE_INDEX_SHORT_SLOTS &&
+        self->words[(int)opt->short_name] != 0) {
+        return true;
+    }
+    if (opt->long_name == CARGPARSE_NO_LONG) return false;
+
+    slot = _cargparse_hash(opt->long_name, strlen(opt->long_name)) % n_long_slots;
+    while (long_slots[slot] != 0) {
+        if (strcmp(self->options[long_slots[slot] - 1].long_name, opt->long_name) == 0) return true;
+        slot = (slot + 1) % n_long_slots;
+    }
+    return false;
+}
+
+cargparse_err_e
+cargparse_builder_add(cargparse_builder_t *const self, const cargparse_option_t *const opt) {
+    cargparse_err_e ret;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!opt) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (self->parse_res) {
+        _cargparse_set_err_msg("Options added after freeze", opt->long_name);
+        return CARGPARSE_ERR_FROZEN;
+    }
+    if (opt->short_name == CARGPARSE_NO_SHORT && opt->long_name == CARGPARSE_NO_LONG) {
+        _cargparse_set_err_msg("Option without a name", NULL);
+        return CARGPARSE_ERR_INVALID_OPTION;
+    }
+    if (self->n_options == self->max_options && (ret = _cargparse_builder_grow(self)) != CARGPARSE_OK) {
+        return ret;
+    }
+    if (_cargparse_builder_has_name(self, opt)) {
+        _cargparse_set_err_msg("Duplicate option name", opt->long_name);
+        return CARGPARSE_ERR_INVALID_OPTION;
+    }
+
+    memcpy(&self->options[self->n_options], opt, sizeof(cargparse_option_t));
+    _cargparse_index_insert(self->words, self->n_words, self->hot, self->options, self->n_options);
+    self->n_options++;
+    return CARGPARSE_OK;
+}
+
+cargparse_err_e
+cargparse_builder_freeze(cargparse_builder_t *const self, cargparse_t *const parser) {
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!parser) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    if (!self->parse_res && !(self->parse_res = calloc(self->n_options + 1, sizeof(cargparse_parse_res_t)))) {
+        _cargparse_set_err_msg("Out of memory", NULL);
+        return CARGPARSE_ERR_NO_MEMORY;
+    }
+    {
+        cargparse_t frozen = {self->usages,
+                              self->description,
+                              self->epilog,
+                              self->options,
+                              self->parse_res,
+                              self->n_options,
+                              {self->words, self->n_words, self->words != NULL, self->hot},
+                              NULL,
+                              NULL,
+                              0,
+                              NULL,
+                              NULL,
+                              NULL};
+        memcpy(parser, &frozen, sizeof(cargparse_t));
+    }
+    return CARGPARSE_OK;
+}
+
+void
+cargparse_builder_destroy(cargparse_builder_t *const self) {
+    if (!self) return;
+    free(self->options);
+    free(self->words);
+    free(self->hot);
+    free(self->parse_res);
+    memset(self, 0, sizeof(*self));
+}
+
+CARGPARSE_INLINE int
 _cargparse_search_long_option(const cargparse_t *const self, const char *long_name) {
     int i;
+    unsigned hash, slot, n_long_slots, name_len;
+    size_t len;
+    const unsigned *long_slots;
+    const cargparse_option_hot_t *hot = self->index.hot;
+
+    CARGPARSE_TRACE_COUNT(self, lookups);
+    if (self->index.is_built) {
+        long_slots = self->index.words + CARGPARSE_INDEX_SHORT_SLOTS;
+        n_long_slots = self->index.n_words - CARGPARSE_INDEX_SHORT_SLOTS;
+        len = strlen(long_name);
+        hash = _cargparse_hash(long_name, len);
+        name_len = _cargparse_hot_name_len(len);
+        slot = hash % n_long_slots;
+        while (long_slots[slot] != 0) {
+            /* other names in the probe chain are told apart without touching their strings */
+            i = (int)long_slots[slot] - 1;
+            if ((!hot || (hot[i].hash == hash && hot[i].name_len == name_len)) &&
+                strcmp(self->options[i].long_name, long_name) == 0) {
+                return i;
+            }
+            slot = (slot + 1) % n_long_slots;
+        }
+        return -1;
+    }
+
     for (i = 0; i < self->n_options; i++) {
         if (self->options[i].long_name != CARGPARSE_NO_LONG &&
             strcmp(self->options[i].long_name, long_name) == 0) {
@@ -125,9 +627,15 @@ _cargparse_search_long_option(const cargparse_t *const self, const char *long_na
     return -1;
 }
 
-static int
+CARGPARSE_INLINE int
 _cargparse_search_short_option(const cargparse_t *const self, const char short_name) {
     int i;
+
+    CARGPARSE_TRACE_COUNT(self, lookups);
+    if (self->index.is_built && short_name > 0 && (unsigned char)short_name < CARGPARSE_INDEX_SHORT_SLOTS) {
+        return (int)self->index.words[(int)short_name] - 1;
+    }
+
     for (i = 0; i < self->n_options; i++) {
         if (self->options[i].short_name != CARGPARSE_NO_SHORT && self->options[i].short_name == short_name) {
             return i;
@@ -136,11 +644,34 @@ _cargparse_search_short_option(const cargparse_t *const self, const char short_n
     return -1;
 }
 
+/* Fields read for every token, from the packed records once cargparse_prepare has built them */
+static cargparse_option_type_e
+_cargparse_opt_type(const cargparse_t *const self, const int i) {
+    return self->index.is_built && self->index.hot ? (cargparse_option_type_e)self->index.hot[i].type
+                                                   : self->options[i].type;
+}
+
+static int
+_cargparse_opt_nargs(const cargparse_t *const self, const int i) {
+    return self->index.is_built && self->index.hot ? self->index.hot[i].nargs : self->options[i].nargs;
+}
+
+static int
+_cargparse_opt_flags(const cargparse_t *const self, const int i) {
+    return self->index.is_built && self->index.hot ? self->index.hot[i].flags : self->options[i].flags;
+}
+
+static bool
+_cargparse_opt_is_variadic(const cargparse_t *const self, const int i) {
+    int nargs = _cargparse_opt_nargs(self, i);
+    return nargs == CARGPARSE_NARGS_ONE_OR_MORE || nargs == CARGPARSE_NARGS_ZERO_OR_MORE;
+}
+
 static int
 _cargparse_get_next_positional_opt(const cargparse_t *const self, const int prev_pos_i) {
     int i;
     for (i = prev_pos_i + 1; i < self->n_options; i++) {
-        if (self->options[i].type == CARGPARSE_OPTION_TYPE_POS) {
+        if (_cargparse_opt_type(self, i) == CARGPARSE_OPTION_TYPE_POS) {
             return i;
         }
     }
@@ -207,6 +738,31 @@ _cargparse_parse_float(const char *arg, double *result) {
     return CARGPARSE_OK;
 }
 
+static cargparse_err_e
+_cargparse_parse_bool(const char *arg, bool *result) {
+    static const char *const TRUE_STR[] = {"1", "true", "yes", "on"};
+    static const char *const FALSE_STR[] = {"", "0", "false", "no", "off"};
+    size_t i;
+
+    if (!arg) {
+        return CARGPARSE_ERR_NULL_ARGUMENT;
+    }
+    for (i = 0; i < sizeof(TRUE_STR) / sizeof(*TRUE_STR); i++) {
+        if (strcmp(arg, TRUE_STR[i]) == 0) {
+            *result = true;
+            return CARGPARSE_OK;
+        }
+    }
+    for (i = 0; i < sizeof(FALSE_STR) / sizeof(*FALSE_STR); i++) {
+        if (strcmp(arg, FALSE_STR[i]) == 0) {
+            *result = false;
+            return CARGPARSE_OK;
+        }
+    }
+    _cargparse_set_err_msg("Not a valid bool", arg);
+    return CARGPARSE_ERR_INVALID_VALUE;
+}
+
 static bool
 _cargparse_is_valid_int(const char *str) {
     long dummy;
@@ -219,43 +775,136 @@ _cargparse_is_valid_float(const char *str) {
     return _cargparse_parse_float(str, &dummy) == CARGPARSE_OK;
 }
 
+/* `key[=value][,key[=value]]...` with non-empty keys */
+static bool
+_cargparse_is_valid_map(const char *str) {
+    bool in_key = true;
+    const char *item = str;
+
+    for (;; str++) {
+        if (*str == ',' || *str == '\0') {
+            if (in_key && str == item) return false;
+            if (*str == '\0') return true;
+            item = str + 1;
+            in_key = true;
+        } else if (*str == '=' && in_key) {
+            if (str == item) return false;
+            in_key = false;
+        }
+    }
+}
+
+/* Invalidates the values kept from the last parse, clearing them only when the stamp wraps */
+static void
+_cargparse_lazy_reset(cargparse_lazy_t *const lazy) {
+    lazy->argv = NULL;
+    lazy->argc = 0;
+    if (++lazy->stamp == 0) {
+        if (lazy->max_values) memset(lazy->values, 0, sizeof(cargparse_lazy_value_t) * lazy->max_values);
+        lazy->stamp = 1;
+    }
+}
+
+/* INT or FLOAT value at `arg`, kept for the next read when `arg` is in the argv of a lazy parser */
 static cargparse_err_e
-_cargparse_set_parse_res(const cargparse_option_type_e type, char **arg_str, cargparse_parse_res_t *parse_res,
-                         const cargparse_option_t *opt) {
-    switch (type) {
+_cargparse_convert_number(const cargparse_t *const self, const cargparse_option_type_e type, char **arg,
+                          void *result) {
+    cargparse_err_e ret;
+    cargparse_lazy_t *lazy = self->lazy;
+    cargparse_lazy_value_t *value = NULL;
+
+    if (lazy && lazy->argv && arg >= lazy->argv && arg < lazy->argv + lazy->argc &&
+        (unsigned)(arg - lazy->argv) < lazy->max_values) {
+        value = &lazy->values[arg - lazy->argv];
+        if (value->stamp == lazy->stamp) {
+            if (type == CARGPARSE_OPTION_TYPE_INT) {
+                *(long *)result = value->value.i;
+            } else {
+                *(double *)result = value->value.f;
+            }
+            return CARGPARSE_OK;
+        }
+    }
+
+    if (type == CARGPARSE_OPTION_TYPE_INT) {
+        if ((ret = _cargparse_parse_int(*arg, (long *)result)) != CARGPARSE_OK) return ret;
+        if (value) value->value.i = *(long *)result;
+    } else {
+        if ((ret = _cargparse_parse_float(*arg, (double *)result)) != CARGPARSE_OK) return ret;
+        if (value) value->value.f = *(double *)result;
+    }
+    if (value) value->stamp = lazy->stamp;
+    return CARGPARSE_OK;
+}
+
+static cargparse_err_e
+_cargparse_set_parse_res(const cargparse_t *const self, const int opt_idx, char **arg_str) {
+    int nargs = _cargparse_opt_nargs(self, opt_idx);
+    cargparse_parse_res_t *parse_res = &self->parse_res[opt_idx];
+
+    switch (_cargparse_opt_type(self, opt_idx)) {
         case CARGPARSE_OPTION_TYPE_BOOL:
             return CARGPARSE_ERR_INVALID_VALUE;
         case CARGPARSE_OPTION_TYPE_STR:
         case CARGPARSE_OPTION_TYPE_POS:
             break;
         case CARGPARSE_OPTION_TYPE_INT:
-            if (!_cargparse_is_valid_int(*arg_str)) return CARGPARSE_ERR_INVALID_VALUE;
+            if (!self->lazy && !_cargparse_is_valid_int(*arg_str)) return CARGPARSE_ERR_INVALID_VALUE;
             break;
         case CARGPARSE_OPTION_TYPE_FLOAT:
-            if (!_cargparse_is_valid_float(*arg_str)) return CARGPARSE_ERR_INVALID_VALUE;
+            if (!self->lazy && !_cargparse_is_valid_float(*arg_str)) return CARGPARSE_ERR_INVALID_VALUE;
+            break;
+        case CARGPARSE_OPTION_TYPE_MAP:
+            if (!_cargparse_is_valid_map(*arg_str)) {
+                _cargparse_set_err_msg("Not a valid key=value list", *arg_str);
+                return CARGPARSE_ERR_INVALID_VALUE;
+            }
             break;
     }
     if (parse_res->nargs == 0) {
         parse_res->valuestr = arg_str;
         parse_res->nargs = 1;
-        parse_res->is_got = (opt->nargs <= 1) ? true : false;
+        parse_res->is_got = (nargs <= 1) ? true : false;
     } else {
         parse_res->nargs++;
-        parse_res->is_got = (opt->nargs <= parse_res->nargs) ? true : false;
+        parse_res->is_got = (nargs <= parse_res->nargs) ? true : false;
     }
     return CARGPARSE_OK;
 }
 
+static void
+_cargparse_log_event(const cargparse_t *const self, const int opt_idx, const int argv_idx,
+                     const int value_idx) {
+    cargparse_event_log_t *log = self->events;
+
+    if (!log) return;
+    if (log->n_events < log->max_events) {
+        log->events[log->n_events].opt_idx = opt_idx;
+        log->events[log->n_events].argv_idx = argv_idx;
+        log->events[log->n_events].value_idx = value_idx;
+    }
+    log->n_events++;
+}
+
+/* argv overrides values loaded from a config file or the environment */
+static void
+_cargparse_take_from_argv(cargparse_parse_res_t *parse_res) {
+    if (parse_res->source != CARGPARSE_SOURCE_ARGV) {
+        memset(parse_res, 0, sizeof(*parse_res));
+        parse_res->source = CARGPARSE_SOURCE_ARGV;
+    }
+}
+
 static cargparse_err_e
 _cargparse_handle_positional_arg(cargparse_t *const self, char **arg, int *last_pos_i) {
     if (*last_pos_i == -1 || (self->parse_res[*last_pos_i].is_got &&
-                              self->options[*last_pos_i].nargs != CARGPARSE_NARGS_ONE_OR_MORE &&
-                              self->options[*last_pos_i].nargs != CARGPARSE_NARGS_ZERO_OR_MORE)) {
+                              self->parse_res[*last_pos_i].source == CARGPARSE_SOURCE_ARGV &&
+                              !_cargparse_opt_is_variadic(self, *last_pos_i))) {
         *last_pos_i = _cargparse_get_next_positional_opt(self, *last_pos_i);
     }
     if (*last_pos_i != -1) {
-        return _cargparse_set_parse_res(self->options[*last_pos_i].type, arg, &self->parse_res[*last_pos_i],
-                                        &self->options[*last_pos_i]);
+        _cargparse_take_from_argv(&self->parse_res[*last_pos_i]);
+        return _cargparse_set_parse_res(self, *last_pos_i, arg);
     } else {
         _cargparse_set_err_msg("Unexpected positional argument", *arg);
         return CARGPARSE_ERR_UNEXPECTED_POSITIONAL;
@@ -264,51 +913,162 @@ _cargparse_handle_positional_arg(cargparse_t *const self, char **arg, int *last_
 
 static cargparse_err_e
 _cargparse_handle_option_arg(cargparse_t *const self, int opt_idx, char **arg) {
-    if (self->parse_res[opt_idx].is_got && self->options[opt_idx].nargs != CARGPARSE_NARGS_ONE_OR_MORE &&
-        self->options[opt_idx].nargs != CARGPARSE_NARGS_ZERO_OR_MORE) {
+    if (self->parse_res[opt_idx].is_got && !_cargparse_opt_is_variadic(self, opt_idx) &&
+        _cargparse_opt_type(self, opt_idx) != CARGPARSE_OPTION_TYPE_MAP) {
         _cargparse_set_err_msg("Option already got", *arg);
         return CARGPARSE_ERR_OPTION_ALREADY_SET;
     }
-    return _cargparse_set_parse_res(self->options[opt_idx].type, arg, &self->parse_res[opt_idx],
-                                    &self->options[opt_idx]);
+    return _cargparse_set_parse_res(self, opt_idx, arg);
 }
 
 static cargparse_err_e
-_cargparse_handle_short_option(cargparse_t *const self, const char *arg, int *opt_idx) {
+_cargparse_handle_short_option(cargparse_t *const self, const char *arg, const int argv_idx, int *opt_idx) {
     *opt_idx = _cargparse_search_short_option(self, arg[1]);
     if (*opt_idx == -1) {
         _cargparse_set_err_msg("Unknown option", arg);
         return CARGPARSE_ERR_OPTION_UNKNOWN;
     }
-    if (self->options[*opt_idx].type == CARGPARSE_OPTION_TYPE_BOOL) {
+    CARGPARSE_TRACE_EVENT(self, CARGPARSE_TRACE_MATCH, *opt_idx, arg, 0);
+    _cargparse_log_event(self, *opt_idx, argv_idx, -1);
+    _cargparse_take_from_argv(&self->parse_res[*opt_idx]);
+    if (_cargparse_opt_type(self, *opt_idx) == CARGPARSE_OPTION_TYPE_BOOL) {
         self->parse_res[*opt_idx].is_got = true;
         self->parse_res[*opt_idx].nargs = 1;
         *opt_idx = -1;
-    } else if (self->options[*opt_idx].nargs == CARGPARSE_NARGS_ZERO_OR_MORE) {
+    } else if (_cargparse_opt_nargs(self, *opt_idx) == CARGPARSE_NARGS_ZERO_OR_MORE) {
         self->parse_res[*opt_idx].is_got = true;
     }
     return CARGPARSE_OK;
 }
 
+/* Optimal string alignment distance (Levenshtein plus swaps of adjacent characters), or `bound` + 1 when it
+ * is larger. Only the diagonal band of width 2 * `bound` + 1 is computed, and it stops as soon as a whole
+ * row exceeds `bound`. */
+static int
+_cargparse_edit_distance(const char *a, const int a_len, const char *b, const int b_len, const int bound) {
+    int rows[3][CARGPARSE_MAX_NAME_LEN + 2], *prev2 = rows[0], *prev = rows[1], *cur = rows[2], *tmp;
+    int i, j, lo, hi, best, row_min;
+
+    if (a_len > CARGPARSE_MAX_NAME_LEN || b_len > CARGPARSE_MAX_NAME_LEN) return bound + 1;
+    if (a_len - b_len > bound || b_len - a_len > bound) return bound + 1;
+
+    for (j = 0; j <= b_len; j++) {
+        prev[j] = j;
+    }
+    for (i = 1; i <= a_len; i++) {
+        lo = i - bound > 1 ? i - bound : 1;
+        hi = i + bound < b_len ? i + bound : b_len;
+        /* cells left and right of the band read as out of bound */
+        cur[lo - 1] = lo == 1 ? i : bound + 1;
+        cur[hi + 1] = bound + 1;
+        row_min = cur[lo - 1];
+        for (j = lo; j <= hi; j++) {
+            best = prev[j - 1] + (a[i - 1] != b[j - 1]);
+            if (prev[j] + 1 < best) best = prev[j] + 1;
+            if (cur[j - 1] + 1 < best) best = cur[j - 1] + 1;
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] && prev2[j - 2] + 1 < best) {
+                best = prev2[j - 2] + 1;
+            }
+            cur[j] = best;
+            if (best < row_min) row_min = best;
+        }
+        if (row_min > bound) return bound + 1;
+        tmp = prev2;
+        prev2 = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    return prev[b_len] <= bound ? prev[b_len] : bound + 1;
+}
+
+/* Closest long option name to `name` within an edit distance of 1, or 2 for names of 6 or more
+ * characters. NULL when there is none. */
+static const char *
+_cargparse_suggest_long_option(const cargparse_t *const self, const char *name) {
+    int i, distance, best = -1, best_distance;
+    size_t len = strlen(name), opt_len, bound = len < 6 ? 1 : 2;
+    const cargparse_option_hot_t *hot = self->index.is_built ? self->index.hot : NULL;
+
+    best_distance = (int)bound + 1;
+    for (i = 0; i < self->n_options; i++) {
+        /* most names are ruled out by their packed length without reading them */
+        if (hot) {
+            opt_len = hot[i].name_len;
+            if (opt_len == 0) continue;
+        } else {
+            if (!self->options[i].long_name) continue;
+            opt_len = strlen(self->options[i].long_name);
+        }
+        if (opt_len + bound < len || len + bound < opt_len) continue;
+        if (_cargparse_opt_type(self, i) == CARGPARSE_OPTION_TYPE_POS) continue;
+
+        distance = _cargparse_edit_distance(name, (int)len, self->options[i].long_name, (int)opt_len,
+                                            best_distance - 1);
+        if (distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+    return best == -1 ? NULL : self->options[best].long_name;
+}
+
+const char *
+cargparse_suggest_option(const cargparse_t *const self, const char *long_name) {
+    if (!self || !long_name) return NULL;
+    return _cargparse_suggest_long_option(self, long_name);
+}
+
+/* "<name>, did you mean <prefix><suggestion>?" when there is a close name */
+static void
+_cargparse_set_unknown_err_msg(const cargparse_t *const self, const char *msg, const char *name,
+                               const char *prefix) {
+    char arg[CARGPARSE_MAX_ERR_MSG_LEN];
+    size_t len = 0, part_len, i;
+    const char *parts[5];
+    const char *suggestion = _cargparse_suggest_long_option(self, name + strlen(prefix));
+
+    if (!suggestion) {
+        _cargparse_set_err_msg(msg, name);
+        return;
+    }
+    parts[0] = name;
+    parts[1] = ", did you mean ";
+    parts[2] = prefix;
+    parts[3] = suggestion;
+    parts[4] = "?";
+    for (i = 0; i < 5; i++) {
+        part_len = strlen(parts[i]);
+        if (len + part_len >= sizeof(arg)) part_len = sizeof(arg) - 1 - len;
+        memcpy(arg + len, parts[i], part_len);
+        len += part_len;
+    }
+    arg[len] = '\0';
+    _cargparse_set_err_msg(msg, arg);
+}
+
 static cargparse_err_e
-_cargparse_handle_long_option(cargparse_t *const self, const char *arg, int *opt_idx) {
+_cargparse_handle_long_option(cargparse_t *const self, const char *arg, const int argv_idx, int *opt_idx) {
     *opt_idx = _cargparse_search_long_option(self, arg + 2);
     if (*opt_idx == -1) {
-        _cargparse_set_err_msg("Unknown option", arg);
+        _cargparse_set_unknown_err_msg(self, "Unknown option", arg, "--");
         return CARGPARSE_ERR_OPTION_UNKNOWN;
     }
-    if (self->options[*opt_idx].type == CARGPARSE_OPTION_TYPE_BOOL) {
+    CARGPARSE_TRACE_EVENT(self, CARGPARSE_TRACE_MATCH, *opt_idx, arg, 0);
+    _cargparse_log_event(self, *opt_idx, argv_idx, -1);
+    _cargparse_take_from_argv(&self->parse_res[*opt_idx]);
+    if (_cargparse_opt_type(self, *opt_idx) == CARGPARSE_OPTION_TYPE_BOOL) {
         self->parse_res[*opt_idx].is_got = true;
         self->parse_res[*opt_idx].nargs = 1;
         *opt_idx = -1;
-    } else if (self->options[*opt_idx].nargs == CARGPARSE_NARGS_ZERO_OR_MORE) {
+    } else if (_cargparse_opt_nargs(self, *opt_idx) == CARGPARSE_NARGS_ZERO_OR_MORE) {
         self->parse_res[*opt_idx].is_got = true;
     }
     return CARGPARSE_OK;
 }
 
 static cargparse_err_e
-_cargparse_handle_mult_short_bool_options(cargparse_t *const self, const char *arg, int *opt_idx) {
+_cargparse_handle_mult_short_bool_options(cargparse_t *const self, const char *arg, const int argv_idx,
+                                          int *opt_idx) {
     int local_opt_idx, i;
     *opt_idx = -1;
 
@@ -318,10 +1078,13 @@ _cargparse_handle_mult_short_bool_options(cargparse_t *const self, const char *a
             _cargparse_set_err_msg("Unknown option", arg);
             return CARGPARSE_ERR_OPTION_UNKNOWN;
         }
-        if (self->options[local_opt_idx].type != CARGPARSE_OPTION_TYPE_BOOL) {
+        if (_cargparse_opt_type(self, local_opt_idx) != CARGPARSE_OPTION_TYPE_BOOL) {
             _cargparse_set_err_msg("Not a bool option in grouped flags", arg);
             return CARGPARSE_ERR_NOT_BOOL_IN_MULT_BOOL_DEF;
         }
+        CARGPARSE_TRACE_EVENT(self, CARGPARSE_TRACE_MATCH, local_opt_idx, arg, 0);
+        _cargparse_log_event(self, local_opt_idx, argv_idx, -1);
+        _cargparse_take_from_argv(&self->parse_res[local_opt_idx]);
         self->parse_res[local_opt_idx].is_got = true;
         self->parse_res[local_opt_idx].nargs = 1;
     }
@@ -333,97 +1096,324 @@ static bool
 _cargparse_check_required_options(const cargparse_t *const self) {
     int i;
     for (i = 0; i < self->n_options; i++) {
-        if ((self->options[i].flags & CARGPARSE_FLAG_REQUIRED && !self->parse_res[i].is_got)) {
+        if ((_cargparse_opt_flags(self, i) & CARGPARSE_FLAG_REQUIRED && !self->parse_res[i].is_got)) {
             return false;
         }
     }
     return true;
 }
 
-cargparse_err_e
-cargparse_parse(cargparse_t *const self, const int argc, char **argv) {
-    int i, opt_idx = -1, last_pos_i = -1;
-    bool after_double_hyphen = false;
-    char **arg;
+/* Sets an option from a single value found outside of argv. The value must outlive the parser. Options
+ * with a fixed count of several values cannot be completed by one, they are rejected. */
+static cargparse_err_e
+_cargparse_set_fallback_value(cargparse_t *const self, const int opt_idx, char *value,
+                              const cargparse_source_e source) {
+    bool valuebool;
     cargparse_err_e ret;
-    cargparse_arg_type_e type;
+    cargparse_parse_res_t *parse_res = &self->parse_res[opt_idx];
 
-    if (argc == 1) return CARGPARSE_GOT_ZERO_ARGS;
-    if (!self) return CARGPARSE_ERR_NULL_PARSER;
-    if (!argv) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (_cargparse_opt_nargs(self, opt_idx) > 1) {
+        _cargparse_set_err_msg("Option takes several values, give them in argv",
+                               self->options[opt_idx].long_name);
+        return CARGPARSE_ERR_INVALID_VALUE;
+    }
+    memset(parse_res, 0, sizeof(*parse_res));
+    parse_res->source = source;
+    if (_cargparse_opt_type(self, opt_idx) == CARGPARSE_OPTION_TYPE_BOOL) {
+        if ((ret = _cargparse_parse_bool(value, &valuebool)) != CARGPARSE_OK) return ret;
+        parse_res->is_got = valuebool;
+        parse_res->nargs = valuebool ? 1 : 0;
+        return CARGPARSE_OK;
+    }
+    parse_res->value = value;
+    return _cargparse_set_parse_res(self, opt_idx, &parse_res->value);
+}
 
-    for (i = 1; i < argc; i++) {
-        arg = &argv[i];
-        type = _cargparse_get_arg_type(*arg);
+/* One pass over environ: prefixed names are mapped back to long names and resolved through the index,
+ * so the cost does not depend on the number of options. */
+static cargparse_err_e
+_cargparse_apply_env(cargparse_t *const self) {
+    int opt_idx;
+    char name[CARGPARSE_MAX_NAME_LEN], c;
+    char **env;
+    const char *eq;
+    size_t i, len, prefix_len = strlen(self->env_prefix);
+    cargparse_err_e ret;
+
+    if (!environ) return CARGPARSE_OK;
 
-        if (after_double_hyphen && type != CARGPARSE_ARG_DOUBLE_HYPHEN) {
-            type = CARGPARSE_ARG_POS;
+    for (env = environ; *env; env++) {
+        if (strncmp(*env, self->env_prefix, prefix_len) != 0) continue;
+        if (!(eq = strchr(*env + prefix_len, '='))) continue;
+        len = (size_t)(eq - *env) - prefix_len;
+        if (len == 0 || len >= sizeof(name)) continue;
+
+        for (i = 0; i < len; i++) {
+            c = (*env)[prefix_len + i];
+            name[i] = c == '_' ? '-' : (char)tolower((unsigned char)c);
         }
+        name[len] = '\0';
 
-        switch (type) {
-            case CARGPARSE_ARG_POS:
-                if (opt_idx == -1) {
-                    if ((ret = _cargparse_handle_positional_arg(self, arg, &last_pos_i)) != CARGPARSE_OK) {
-                        return ret;
-                    }
-                } else {
-                    if ((ret = _cargparse_handle_option_arg(self, opt_idx, arg)) != CARGPARSE_OK) {
-                        return ret;
-                    }
-                    if (self->parse_res[opt_idx].is_got &&
-                        self->options[opt_idx].nargs != CARGPARSE_NARGS_ONE_OR_MORE &&
-                        self->options[opt_idx].nargs != CARGPARSE_NARGS_ZERO_OR_MORE) {
-                        opt_idx = -1;
-                    }
-                }
+        opt_idx = _cargparse_search_long_option(self, name);
+        if (opt_idx == -1 || !(_cargparse_opt_flags(self, opt_idx) & CARGPARSE_FLAG_ENV)) continue;
+        if (self->parse_res[opt_idx].source > CARGPARSE_SOURCE_ENV) continue;
+
+        if ((ret = _cargparse_set_fallback_value(self, opt_idx, (char *)eq + 1, CARGPARSE_SOURCE_ENV)) !=
+            CARGPARSE_OK) {
+            _cargparse_set_err_msg("Invalid value in environment variable", *env);
+            return ret;
+        }
+    }
+    return CARGPARSE_OK;
+}
+
+static char *
+_cargparse_trim(char *start, char **end) {
+    while (start < *end && isspace((unsigned char)*start)) start++;
+    while (*end > start && isspace((unsigned char)(*end)[-1])) (*end)--;
+    return start;
+}
+
+static cargparse_err_e
+_cargparse_load_config_line(cargparse_t *const self, char *line, char *line_end) {
+    int opt_idx;
+    char *key, *key_end, *value, *value_end;
+
+    line = _cargparse_trim(line, &line_end);
+    if (line == line_end || *line == '#') return CARGPARSE_OK;
+
+    if (!(key_end = memchr(line, '=', (size_t)(line_end - line)))) {
+        *line_end = '\0';
+        _cargparse_set_err_msg("Expected 'key = value' in config", line);
+        return CARGPARSE_ERR_CONFIG_SYNTAX;
+    }
+    value_end = line_end;
+    value = _cargparse_trim(key_end + 1, &value_end);
+    key = _cargparse_trim(line, &key_end);
+    if (value_end - value >= 2 && *value == '"' && value_end[-1] == '"') {
+        value++;
+        value_end--;
+    }
+    *key_end = '\0';
+    *value_end = '\0';
+
+    opt_idx = _cargparse_search_long_option(self, key);
+    if (opt_idx == -1) {
+        _cargparse_set_unknown_err_msg(self, "Unknown config key", key, "");
+        return CARGPARSE_ERR_OPTION_UNKNOWN;
+    }
+    if (self->parse_res[opt_idx].source == CARGPARSE_SOURCE_FILE) {
+        _cargparse_set_err_msg("Option already got", key);
+        return CARGPARSE_ERR_OPTION_ALREADY_SET;
+    }
+    return _cargparse_set_fallback_value(self, opt_idx, value, CARGPARSE_SOURCE_FILE);
+}
+
+cargparse_err_e
+cargparse_load_config(cargparse_t *const self, const char *path) {
+    int fd;
+    struct stat st;
+    char *map, *line, *line_end, *end;
+    cargparse_err_e ret;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!path) return CARGPARSE_ERR_NULL_ARGUMENT;
+
+    _cargparse_clear_err_msg();
+    cargparse_unload_config(self);
+    cargparse_prepare(self);
+
+    if ((fd = open(path, O_RDONLY)) == -1) {
+        _cargparse_set_err_msg("Cannot open config", path);
+        return CARGPARSE_ERR_CONFIG_IO;
+    }
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        _cargparse_set_err_msg("Cannot stat config", path);
+        return CARGPARSE_ERR_CONFIG_IO;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return CARGPARSE_OK;
+    }
+
+    /* one spare zero byte after the file terminates the last value when there is no trailing newline;
+     * the file is mapped over an anonymous reservation so that byte exists even on a page boundary */
+    map = mmap(NULL, (size_t)st.st_size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED || mmap(map, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                                  fd, 0) == MAP_FAILED) {
+        if (map != MAP_FAILED) munmap(map, (size_t)st.st_size + 1);
+        close(fd);
+        _cargparse_set_err_msg("Cannot map config", path);
+        return CARGPARSE_ERR_CONFIG_IO;
+    }
+    close(fd);
+    self->config_map = map;
+    self->config_size = (size_t)st.st_size + 1;
+
+    end = map + st.st_size;
+    for (line = map; line < end; line = line_end + 1) {
+        if (!(line_end = memchr(line, '\n', (size_t)(end - line)))) {
+            line_end = end;
+        }
+        if ((ret = _cargparse_load_config_line(self, line, line_end)) != CARGPARSE_OK) {
+            return ret;
+        }
+    }
+    return CARGPARSE_OK;
+}
+
+void
+cargparse_unload_config(cargparse_t *const self) {
+    int i;
+
+    if (!self || !self->config_map) return;
+
+    for (i = 0; i < self->n_options; i++) {
+        if (self->parse_res[i].source == CARGPARSE_SOURCE_FILE) {
+            memset(&self->parse_res[i], 0, sizeof(cargparse_parse_res_t));
+        }
+    }
+    munmap(self->config_map, self->config_size);
+    self->config_map = NULL;
+    self->config_size = 0;
+}
+
+void
+cargparse_set_env_prefix(cargparse_t *const self, const char *prefix) {
+    if (self) self->env_prefix = prefix;
+}
+
+/* Action of the parse loop for each state and token class; every token is classified once by
+ * _cargparse_get_arg_type and dispatched with a single lookup instead of nested checks of the pending option.
+ * Empty tokens are skipped unless they follow "--". */
+/* clang-format off */
+static const unsigned char CARGPARSE_PARSE_TABLE[CARGPARSE_N_STATES][CARGPARSE_N_ARG_TYPES] = {
+    /* columns: INCORRECT, POS, SHORT, LONG, DOUBLE_HYPHEN */
+    /* NONE */       {CARGPARSE_ACTION_SKIP,       CARGPARSE_ACTION_POSITIONAL, CARGPARSE_ACTION_SHORT,
+                      CARGPARSE_ACTION_LONG,       CARGPARSE_ACTION_DOUBLE_HYPHEN},
+    /* NEEDS_ARG */  {CARGPARSE_ACTION_SKIP,       CARGPARSE_ACTION_VALUE,      CARGPARSE_ACTION_ERR_PENDING,
+                      CARGPARSE_ACTION_ERR_PENDING, CARGPARSE_ACTION_ERR_PENDING_DH},
+    /* VARIADIC */   {CARGPARSE_ACTION_SKIP,       CARGPARSE_ACTION_VALUE,      CARGPARSE_ACTION_SHORT,
+                      CARGPARSE_ACTION_LONG,       CARGPARSE_ACTION_DOUBLE_HYPHEN},
+    /* POSITIONAL */ {CARGPARSE_ACTION_POSITIONAL, CARGPARSE_ACTION_POSITIONAL, CARGPARSE_ACTION_POSITIONAL,
+                      CARGPARSE_ACTION_POSITIONAL, CARGPARSE_ACTION_DOUBLE_HYPHEN},
+};
+/* clang-format on */
+
+/* State after an option token matched `opt_idx`, -1 for options that take no values */
+static cargparse_parse_state_e
+_cargparse_option_state(const cargparse_t *const self, const int opt_idx) {
+    if (opt_idx == -1) return CARGPARSE_STATE_NONE;
+    return _cargparse_opt_is_variadic(self, opt_idx) ? CARGPARSE_STATE_VARIADIC : CARGPARSE_STATE_NEEDS_ARG;
+}
+
+static void
+_cargparse_parse_begin(cargparse_stream_t *const stream, cargparse_t *const self) {
+    stream->parser = self;
+    stream->n_tokens = 1;
+    stream->opt_idx = -1;
+    stream->last_pos_i = -1;
+    stream->state = CARGPARSE_STATE_NONE;
+    stream->error = CARGPARSE_OK;
+    if (self->events) self->events->n_events = 0;
+    if (self->lazy) _cargparse_lazy_reset(self->lazy);
+
+    CARGPARSE_TRACE_PHASE(self, CARGPARSE_PHASE_PREPARE);
+    cargparse_prepare(self);
+}
+
+/* Parses argv[stream->n_tokens..argc), the loop works on copies of the stream state */
+static cargparse_err_e
+_cargparse_parse_feed(cargparse_stream_t *const stream, const int argc, char **argv) {
+    int i, opt_idx = stream->opt_idx, last_pos_i = stream->last_pos_i;
+    char **arg;
+    cargparse_err_e ret;
+    cargparse_arg_type_e type;
+    cargparse_parse_state_e state = (cargparse_parse_state_e)stream->state;
+    cargparse_t *const self = stream->parser;
+
+    if (self->lazy) {
+        self->lazy->argv = argv;
+        self->lazy->argc = argc;
+    }
+    CARGPARSE_TRACE_PHASE(self, CARGPARSE_PHASE_ARGV);
+    for (i = stream->n_tokens; i < argc; i++) {
+        arg = &argv[i];
+        type = _cargparse_get_arg_type(*arg);
+        CARGPARSE_TRACE_EVENT(self, CARGPARSE_TRACE_TOKEN, -1, *arg,
+                              state == CARGPARSE_STATE_POSITIONAL && type != CARGPARSE_ARG_DOUBLE_HYPHEN
+                                  ? (int)CARGPARSE_ARG_POS
+                                  : (int)type);
+
+        switch ((cargparse_parse_action_e)CARGPARSE_PARSE_TABLE[state][type + 1]) {
+            case CARGPARSE_ACTION_SKIP:
                 break;
-            case CARGPARSE_ARG_SHORT:
-                if (self->options[opt_idx].nargs == CARGPARSE_NARGS_ONE_OR_MORE ||
-                    self->options[opt_idx].nargs == CARGPARSE_NARGS_ZERO_OR_MORE) {
-                    opt_idx = -1;
-                } else if (opt_idx != -1) {
-                    _cargparse_set_err_msg("previous option not set", NULL); /* TODO: add pointer to arg */
-                    return CARGPARSE_ERR_OPTION_NEEDS_ARG;
-                }
-                if (strlen(*arg) > 2 &&
-                    (ret = _cargparse_handle_mult_short_bool_options(self, *arg, &opt_idx)) != CARGPARSE_OK) {
-                    return ret;
-                } else if ((ret = _cargparse_handle_short_option(self, *arg, &opt_idx)) != CARGPARSE_OK) {
+            case CARGPARSE_ACTION_POSITIONAL:
+                if ((ret = _cargparse_handle_positional_arg(self, arg, &last_pos_i)) != CARGPARSE_OK) {
                     return ret;
                 }
+                _cargparse_log_event(self, last_pos_i, i, self->parse_res[last_pos_i].nargs - 1);
                 break;
-            case CARGPARSE_ARG_LONG:
-                if (self->options[opt_idx].nargs == CARGPARSE_NARGS_ONE_OR_MORE ||
-                    self->options[opt_idx].nargs == CARGPARSE_NARGS_ZERO_OR_MORE) {
-                    opt_idx = -1;
-                } else if (opt_idx != -1) {
-                    _cargparse_set_err_msg("previous option not set", NULL); /* TODO: add pointer to arg */
-                    return CARGPARSE_ERR_OPTION_NEEDS_ARG;
-                }
-                if ((ret = _cargparse_handle_long_option(self, *arg, &opt_idx)) != CARGPARSE_OK) {
+            case CARGPARSE_ACTION_VALUE:
+                if ((ret = _cargparse_handle_option_arg(self, opt_idx, arg)) != CARGPARSE_OK) {
                     return ret;
                 }
+                _cargparse_log_event(self, opt_idx, i, self->parse_res[opt_idx].nargs - 1);
+                /* variadic options keep taking values */
+                if (state == CARGPARSE_STATE_NEEDS_ARG && self->parse_res[opt_idx].is_got) {
+                    state = CARGPARSE_STATE_NONE;
+                }
                 break;
-            case CARGPARSE_ARG_DOUBLE_HYPHEN:
-                if (self->options[opt_idx].nargs != CARGPARSE_NARGS_ONE_OR_MORE &&
-                    self->options[opt_idx].nargs != CARGPARSE_NARGS_ZERO_OR_MORE && opt_idx != -1) {
-                    _cargparse_set_err_msg("got '--' when previous option not set", NULL);
-                    return CARGPARSE_ERR_OPTION_NEEDS_ARG;
+            case CARGPARSE_ACTION_SHORT:
+                /* longer short tokens are clusters of boolean options */
+                ret = (*arg)[2] != '\0' ? _cargparse_handle_mult_short_bool_options(self, *arg, i, &opt_idx)
+                                        : _cargparse_handle_short_option(self, *arg, i, &opt_idx);
+                if (ret != CARGPARSE_OK) return ret;
+                state = _cargparse_option_state(self, opt_idx);
+                break;
+            case CARGPARSE_ACTION_LONG:
+                if ((ret = _cargparse_handle_long_option(self, *arg, i, &opt_idx)) != CARGPARSE_OK) {
+                    return ret;
                 }
-                last_pos_i = _cargparse_get_next_positional_opt(self, last_pos_i);
-                after_double_hyphen = true;
-                opt_idx = -1;
+                state = _cargparse_option_state(self, opt_idx);
                 break;
-            case CARGPARSE_ARG_INCORRECT:
+            case CARGPARSE_ACTION_DOUBLE_HYPHEN:
+                last_pos_i = _cargparse_get_next_positional_opt(self, last_pos_i);
+                state = CARGPARSE_STATE_POSITIONAL;
                 break;
+            case CARGPARSE_ACTION_ERR_PENDING:
+                _cargparse_set_err_msg("previous option not set", NULL); /* TODO: add pointer to arg */
+                return CARGPARSE_ERR_OPTION_NEEDS_ARG;
+            case CARGPARSE_ACTION_ERR_PENDING_DH:
+                _cargparse_set_err_msg("got '--' when previous option not set", NULL);
+                return CARGPARSE_ERR_OPTION_NEEDS_ARG;
         }
     }
 
-    if (opt_idx != -1) {
+    stream->n_tokens = argc > stream->n_tokens ? argc : stream->n_tokens;
+    stream->opt_idx = opt_idx;
+    stream->last_pos_i = last_pos_i;
+    stream->state = (int)state;
+    return CARGPARSE_OK;
+}
+
+static cargparse_err_e
+_cargparse_parse_finish(cargparse_stream_t *const stream) {
+    cargparse_err_e ret;
+    cargparse_t *const self = stream->parser;
+
+    if (stream->state == CARGPARSE_STATE_NEEDS_ARG || stream->state == CARGPARSE_STATE_VARIADIC) {
         _cargparse_set_err_msg("for last option got but not set", NULL); /* TODO: add pointer to arg */
         return CARGPARSE_ERR_OPTION_NEEDS_ARG;
     }
 
+    CARGPARSE_TRACE_PHASE(self, CARGPARSE_PHASE_ENV);
+    if (self->env_prefix && (ret = _cargparse_apply_env(self)) != CARGPARSE_OK) {
+        return ret;
+    }
+
+    CARGPARSE_TRACE_PHASE(self, CARGPARSE_PHASE_CHECK);
     if (!_cargparse_check_required_options(self)) {
         _cargparse_set_err_msg("Not all required options set", NULL);
         return CARGPARSE_ERR_NOT_ALL_REQUIRED_OPTIONS;
@@ -432,7 +1422,319 @@ cargparse_parse(cargparse_t *const self, const int argc, char **argv) {
     return CARGPARSE_OK;
 }
 
-static int
+static cargparse_err_e
+_cargparse_parse(cargparse_t *const self, const int argc, char **argv) {
+    cargparse_err_e ret;
+    cargparse_stream_t stream;
+
+    if (argc == 1) {
+        if (self && self->events) self->events->n_events = 0;
+        if (self && self->lazy) _cargparse_lazy_reset(self->lazy);
+        if (self && self->env_prefix) {
+            CARGPARSE_TRACE_PHASE(self, CARGPARSE_PHASE_PREPARE);
+            cargparse_prepare(self);
+            CARGPARSE_TRACE_PHASE(self, CARGPARSE_PHASE_ENV);
+            if ((ret = _cargparse_apply_env(self)) != CARGPARSE_OK) return ret;
+        }
+        return CARGPARSE_GOT_ZERO_ARGS;
+    }
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!argv) return CARGPARSE_ERR_NULL_ARGUMENT;
+
+    _cargparse_parse_begin(&stream, self);
+    if ((ret = _cargparse_parse_feed(&stream, argc, argv)) != CARGPARSE_OK) return ret;
+    return _cargparse_parse_finish(&stream);
+}
+
+cargparse_err_e
+cargparse_parse(cargparse_t *const self, const int argc, char **argv) {
+    _cargparse_clear_err_msg();
+#ifdef CARGPARSE_TRACE
+    return _cargparse_trace_return(self, _cargparse_parse(self, argc, argv));
+#else
+    return _cargparse_parse(self, argc, argv);
+#endif
+}
+
+void
+cargparse_set_event_log(cargparse_t *const self, cargparse_event_log_t *const log) {
+    if (!self) return;
+    self->events = log;
+    if (log) log->n_events = 0;
+}
+
+void
+cargparse_set_lazy(cargparse_t *const self, cargparse_lazy_t *const lazy) {
+    if (!self) return;
+    self->lazy = lazy;
+    if (!lazy) return;
+    if (lazy->max_values) memset(lazy->values, 0, sizeof(cargparse_lazy_value_t) * lazy->max_values);
+    lazy->stamp = 0;
+    _cargparse_lazy_reset(lazy);
+}
+
+cargparse_err_e
+cargparse_check_values(const cargparse_t *const self) {
+    int opt_idx, narg;
+    long valueint;
+    double valuefloat;
+    cargparse_err_e ret;
+    cargparse_option_type_e type;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+
+    for (opt_idx = 0; opt_idx < self->n_options; opt_idx++) {
+        type = self->options[opt_idx].type;
+        if (type != CARGPARSE_OPTION_TYPE_INT && type != CARGPARSE_OPTION_TYPE_FLOAT) continue;
+        for (narg = 0; narg < self->parse_res[opt_idx].nargs; narg++) {
+            ret = _cargparse_convert_number(self, type, self->parse_res[opt_idx].valuestr + narg,
+                                            type == CARGPARSE_OPTION_TYPE_INT ? (void *)&valueint
+                                                                              : (void *)&valuefloat);
+            if (ret != CARGPARSE_OK) return ret;
+        }
+    }
+    return CARGPARSE_OK;
+}
+
+const cargparse_event_t *
+cargparse_event_next(const cargparse_event_log_t *const log, unsigned *cursor) {
+    if (!log || !cursor || *cursor >= log->n_events || *cursor >= log->max_events) return NULL;
+    return &log->events[(*cursor)++];
+}
+
+cargparse_err_e
+cargparse_parse_begin(cargparse_stream_t *const stream, cargparse_t *const parser) {
+    if (!stream || !parser) return CARGPARSE_ERR_NULL_PARSER;
+
+    _cargparse_clear_err_msg();
+    _cargparse_parse_begin(stream, parser);
+#ifdef CARGPARSE_TRACE
+    return _cargparse_trace_return(parser, CARGPARSE_OK);
+#else
+    return CARGPARSE_OK;
+#endif
+}
+
+/* A failed feed or finish leaves the results half written, so the stream keeps failing */
+static cargparse_err_e
+_cargparse_stream_return(cargparse_stream_t *const stream, cargparse_err_e ret) {
+#ifdef CARGPARSE_TRACE
+    ret = _cargparse_trace_return(stream->parser, ret);
+#endif
+    if (ret != CARGPARSE_OK && ret != CARGPARSE_GOT_ZERO_ARGS) stream->error = ret;
+    return ret;
+}
+
+cargparse_err_e
+cargparse_parse_feed(cargparse_stream_t *const stream, const int argc, char **argv) {
+    if (!stream || !stream->parser) return CARGPARSE_ERR_NULL_PARSER;
+    if (!argv) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (stream->error != CARGPARSE_OK) return stream->error;
+
+    if (argc < stream->n_tokens) {
+        _cargparse_set_err_msg("argv is shorter than the tokens already fed", NULL);
+        return _cargparse_stream_return(stream, CARGPARSE_ERR_INVALID_VALUE);
+    }
+    return _cargparse_stream_return(stream, _cargparse_parse_feed(stream, argc, argv));
+}
+
+cargparse_err_e
+cargparse_parse_finish(cargparse_stream_t *const stream) {
+    cargparse_err_e ret;
+
+    if (!stream || !stream->parser) return CARGPARSE_ERR_NULL_PARSER;
+    if (stream->error != CARGPARSE_OK) return stream->error;
+
+    if (stream->n_tokens <= 1) {
+        CARGPARSE_TRACE_PHASE(stream->parser, CARGPARSE_PHASE_ENV);
+        if (stream->parser->env_prefix && (ret = _cargparse_apply_env(stream->parser)) != CARGPARSE_OK) {
+            return _cargparse_stream_return(stream, ret);
+        }
+        return _cargparse_stream_return(stream, CARGPARSE_GOT_ZERO_ARGS);
+    }
+    return _cargparse_stream_return(stream, _cargparse_parse_finish(stream));
+}
+
+cargparse_err_e
+cargparse_bind(cargparse_t *const self, cargparse_t *const spec, cargparse_parse_res_t *parse_res) {
+    if (!self || !spec) return CARGPARSE_ERR_NULL_PARSER;
+    if (!parse_res) return CARGPARSE_ERR_NULL_ARGUMENT;
+
+    /* the index is built here once, bound parsers only read it */
+    cargparse_prepare(spec);
+    memcpy(self, spec, sizeof(cargparse_t));
+    self->parse_res = parse_res;
+    self->config_map = NULL;
+    self->config_size = 0;
+    self->events = NULL;
+    self->lazy = NULL;
+    self->trace = NULL;
+    memset(parse_res, 0, sizeof(cargparse_parse_res_t) * spec->n_options);
+    return CARGPARSE_OK;
+}
+
+static bool
+_cargparse_is_blank(const char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+cargparse_err_e
+cargparse_split_line(char *line, char **argv, const int max_args, int *argc) {
+    char *read, *write, quote, c;
+    int n = 0;
+
+    _cargparse_clear_err_msg();
+    if (!line || !argc) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (!argv && max_args > 0) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    for (read = line;; read++) {
+        while (_cargparse_is_blank(*read)) read++;
+        if (*read == '\0') break;
+
+        /* quotes and escapes only shorten a word, so it is written over its own text */
+        write = read;
+        if (n < max_args - 1) argv[n] = write;
+        n++;
+        for (quote = '\0'; *read != '\0'; read++) {
+            if (quote == '\'') {
+                if (*read == '\'') {
+                    quote = '\0';
+                } else {
+                    *write++ = *read;
+                }
+            } else if (*read == '\\') {
+                if (read[1] == '\0') {
+                    *argc = n;
+                    _cargparse_set_err_msg("Backslash at the end of the line", NULL);
+                    return CARGPARSE_ERR_LINE_SYNTAX;
+                }
+                /* between double quotes only the characters special there are escaped */
+                if (quote != '"' || strchr("\"\\$`", read[1])) read++;
+                *write++ = *read;
+            } else if (quote == '"') {
+                if (*read == '"') {
+                    quote = '\0';
+                } else {
+                    *write++ = *read;
+                }
+            } else if (*read == '\'' || *read == '"') {
+                quote = *read;
+            } else if (_cargparse_is_blank(*read)) {
+                break;
+            } else {
+                *write++ = *read;
+            }
+        }
+        if (quote != '\0') {
+            *argc = n;
+            _cargparse_set_err_msg("Unterminated quote", NULL);
+            return CARGPARSE_ERR_LINE_SYNTAX;
+        }
+        c = *read;
+        *write = '\0';
+        if (c == '\0') break;
+    }
+
+    *argc = n;
+    if (n >= max_args) return CARGPARSE_ERR_BUFFER_TOO_SMALL;
+    argv[n] = NULL;
+    return CARGPARSE_OK;
+}
+
+static cargparse_command_t *
+_cargparse_command_find(cargparse_command_t *const self, const char *name) {
+    unsigned i, slot;
+    const char *sub_name;
+
+    if (!self->slots || self->n_slots <= self->n_subcommands) {
+        for (i = 0; i < self->n_subcommands; i++) {
+            if (strcmp(self->subcommands[i].name, name) == 0) return &self->subcommands[i];
+        }
+        return NULL;
+    }
+
+    if (!self->is_built) {
+        memset(self->slots, 0, sizeof(unsigned) * self->n_slots);
+        for (i = 0; i < self->n_subcommands; i++) {
+            sub_name = self->subcommands[i].name;
+            slot = _cargparse_hash(sub_name, strlen(sub_name)) % self->n_slots;
+            while (self->slots[slot] != 0) {
+                slot = (slot + 1) % self->n_slots;
+            }
+            self->slots[slot] = i + 1;
+        }
+        self->is_built = true;
+    }
+
+    slot = _cargparse_hash(name, strlen(name)) % self->n_slots;
+    while (self->slots[slot] != 0) {
+        if (strcmp(self->subcommands[self->slots[slot] - 1].name, name) == 0) {
+            return &self->subcommands[self->slots[slot] - 1];
+        }
+        slot = (slot + 1) % self->n_slots;
+    }
+    return NULL;
+}
+
+cargparse_err_e
+cargparse_parse_command(cargparse_command_t *const root, const int argc, char **argv,
+                        cargparse_command_t **selected) {
+    int i;
+    cargparse_command_t *cmd, *sub;
+
+    if (!root) return CARGPARSE_ERR_NULL_PARSER;
+    if (!argv) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (!selected) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    cmd = root;
+    for (i = 1; i < argc && cmd->n_subcommands > 0; i++) {
+        if (!(sub = _cargparse_command_find(cmd, argv[i]))) break;
+        cmd = sub;
+    }
+    *selected = cmd;
+
+    if (!cmd->parser) {
+        if (i < argc) {
+            _cargparse_set_err_msg("Unknown subcommand", argv[i]);
+            return CARGPARSE_ERR_SUBCOMMAND_UNKNOWN;
+        }
+        _cargparse_set_err_msg("Missing subcommand", cmd->name);
+        return CARGPARSE_ERR_SUBCOMMAND_MISSING;
+    }
+
+    /* the last command token takes the place of the program name */
+    return cargparse_parse(cmd->parser, argc - (i - 1), argv + (i - 1));
+}
+
+cargparse_err_e
+cargparse_parse_multicall(cargparse_command_t *const registry, const int argc, char **argv,
+                          cargparse_command_t **selected) {
+    const char *name;
+    cargparse_command_t *applet;
+
+    if (!registry) return CARGPARSE_ERR_NULL_PARSER;
+    if (!argv || argc < 1 || !argv[0]) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (!selected) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    name = strrchr(argv[0], '/');
+    name = name ? name + 1 : argv[0];
+    if ((applet = _cargparse_command_find(registry, name))) {
+        return cargparse_parse_command(applet, argc, argv, selected);
+    }
+
+    *selected = registry;
+    if (argc < 2) {
+        _cargparse_set_err_msg("Missing applet name", name);
+        return CARGPARSE_ERR_SUBCOMMAND_MISSING;
+    }
+    if (!(applet = _cargparse_command_find(registry, argv[1]))) {
+        _cargparse_set_err_msg("Unknown applet", argv[1]);
+        return CARGPARSE_ERR_SUBCOMMAND_UNKNOWN;
+    }
+    return cargparse_parse_command(applet, argc - 1, argv + 1, selected);
+}
+
+CARGPARSE_INLINE int
 _cargparse_find_opt(const cargparse_t *const self, const char short_name, const char *long_name) {
     if (short_name != CARGPARSE_NO_SHORT) {
         return _cargparse_search_short_option(self, short_name);
@@ -443,7 +1745,7 @@ _cargparse_find_opt(const cargparse_t *const self, const char short_name, const
     return -1;
 }
 
-static int
+CARGPARSE_INLINE int
 _cargparse_get_check_opt(const cargparse_t *const self, const cargparse_option_type_e type,
                          const char short_name, const char *long_name) {
     int opt_idx = _cargparse_find_opt(self, short_name, long_name);
@@ -460,10 +1762,9 @@ _cargparse_get_check_opt(const cargparse_t *const self, const cargparse_option_t
     return opt_idx;
 }
 
-static cargparse_err_e
-_cargparse_get_value_generic(const cargparse_t *const self, const cargparse_option_type_e type,
-                             const char short_name, const char *long_name, void *result,
-                             const void *default_value, const unsigned narg) {
+CARGPARSE_INLINE cargparse_err_e
+_cargparse_get_value(const cargparse_t *const self, const cargparse_option_type_e type, const char short_name,
+                     const char *long_name, void *result, const void *default_value, const unsigned narg) {
     if (!self) return CARGPARSE_ERR_NULL_PARSER;
     if (long_name == CARGPARSE_NO_LONG && short_name == CARGPARSE_NO_SHORT)
         return CARGPARSE_ERR_INVALID_OPTION;
@@ -489,6 +1790,7 @@ _cargparse_get_value_generic(const cargparse_t *const self, const cargparse_opti
                 break;
             case CARGPARSE_OPTION_TYPE_STR:
             case CARGPARSE_OPTION_TYPE_POS:
+            case CARGPARSE_OPTION_TYPE_MAP:
                 *(const char **)result = (const char *)default_value;
                 break;
         }
@@ -506,24 +1808,36 @@ _cargparse_get_value_generic(const cargparse_t *const self, const cargparse_opti
             *(bool *)result = true;
             break;
         case CARGPARSE_OPTION_TYPE_INT:
-            if ((ret = _cargparse_parse_int(*(self->parse_res[opt_idx].valuestr + narg), (long *)result)) !=
-                CARGPARSE_OK)
-                return ret;
-            break;
         case CARGPARSE_OPTION_TYPE_FLOAT:
-            if ((ret = _cargparse_parse_float(*(self->parse_res[opt_idx].valuestr + narg),
-                                              (double *)result)) != CARGPARSE_OK)
-                return ret;
+            ret = _cargparse_convert_number(self, type, self->parse_res[opt_idx].valuestr + narg, result);
+            if (ret != CARGPARSE_OK) return ret;
             break;
         case CARGPARSE_OPTION_TYPE_STR:
         case CARGPARSE_OPTION_TYPE_POS:
+        case CARGPARSE_OPTION_TYPE_MAP:
             *(const char **)result = *(self->parse_res[opt_idx].valuestr + narg);
             break;
     }
+    CARGPARSE_TRACE_EVENT(self, CARGPARSE_TRACE_CONVERT, opt_idx,
+                          self->parse_res[opt_idx].valuestr ? self->parse_res[opt_idx].valuestr[narg] : NULL,
+                          (int)narg);
 
     return CARGPARSE_OK;
 }
 
+CARGPARSE_INLINE cargparse_err_e
+_cargparse_get_value_generic(const cargparse_t *const self, const cargparse_option_type_e type,
+                             const char short_name, const char *long_name, void *result,
+                             const void *default_value, const unsigned narg) {
+#ifdef CARGPARSE_TRACE
+    if (self) _cargparse_trace_phase(self, CARGPARSE_PHASE_GET);
+    return _cargparse_trace_return(
+        self, _cargparse_get_value(self, type, short_name, long_name, result, default_value, narg));
+#else
+    return _cargparse_get_value(self, type, short_name, long_name, result, default_value, narg);
+#endif
+}
+
 cargparse_err_e
 cargparse_get_bool_long(const cargparse_t *const self, const char *long_name, bool *valuebool) {
     static const bool default_bool = false;
@@ -587,6 +1901,149 @@ cargparse_get_positional(const cargparse_t *const self, const char *long_name, c
                                         valuestr, (const void *)default_value, idx);
 }
 
+static bool
+_cargparse_is_option_token(const cargparse_option_t *opt, const char *arg) {
+    if (arg[0] != '-') return false;
+    if (opt->short_name != CARGPARSE_NO_SHORT && arg[1] == opt->short_name && arg[2] == '\0') return true;
+    return opt->long_name != CARGPARSE_NO_LONG && arg[1] == '-' && strcmp(arg + 2, opt->long_name) == 0;
+}
+
+static cargparse_err_e
+_cargparse_map_add_pair(cargparse_map_t *map, const char *key, const unsigned key_len, const char *value,
+                        const unsigned value_len) {
+    unsigned slot;
+    const cargparse_kv_t *other;
+
+    if (map->n_pairs == map->max_pairs) {
+        _cargparse_set_err_msg("Too many key=value pairs", key);
+        return CARGPARSE_ERR_MAP_FULL;
+    }
+    map->pairs[map->n_pairs].key.str = key;
+    map->pairs[map->n_pairs].key.len = key_len;
+    map->pairs[map->n_pairs].value.str = value;
+    map->pairs[map->n_pairs].value.len = value_len;
+    map->n_pairs++;
+
+    if (!map->slots || map->n_pairs >= map->n_slots) return CARGPARSE_OK;
+
+    /* the latest pair wins for repeated keys, like later mount options override earlier ones */
+    slot = _cargparse_hash(key, key_len) % map->n_slots;
+    while (map->slots[slot] != 0) {
+        other = &map->pairs[map->slots[slot] - 1];
+        if (other->key.len == key_len && memcmp(other->key.str, key, key_len) == 0) break;
+        slot = (slot + 1) % map->n_slots;
+    }
+    map->slots[slot] = map->n_pairs;
+    return CARGPARSE_OK;
+}
+
+static cargparse_err_e
+_cargparse_map_add_token(cargparse_map_t *map, const char *token) {
+    const char *item = token, *eq = NULL;
+    cargparse_err_e ret;
+
+    for (;; token++) {
+        if (*token == '=' && !eq) {
+            eq = token;
+        } else if (*token == ',' || *token == '\0') {
+            if (eq) {
+                ret = _cargparse_map_add_pair(map, item, (unsigned)(eq - item), eq + 1,
+                                              (unsigned)(token - eq - 1));
+            } else {
+                ret = _cargparse_map_add_pair(map, item, (unsigned)(token - item), token, 0);
+            }
+            if (ret != CARGPARSE_OK) return ret;
+            if (*token == '\0') return CARGPARSE_OK;
+            item = token + 1;
+            eq = NULL;
+        }
+    }
+}
+
+static cargparse_err_e
+_cargparse_get_map(const cargparse_t *const self, const char short_name, const char *long_name,
+                   cargparse_map_t *map) {
+    int opt_idx, got;
+    char **token;
+    cargparse_err_e ret;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (long_name == CARGPARSE_NO_LONG && short_name == CARGPARSE_NO_SHORT)
+        return CARGPARSE_ERR_INVALID_OPTION;
+    if (!map) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    opt_idx = _cargparse_get_check_opt(self, CARGPARSE_OPTION_TYPE_MAP, short_name, long_name);
+    if (opt_idx == -1) {
+        return CARGPARSE_ERR_OPTION_UNKNOWN;
+    }
+
+    map->n_pairs = 0;
+    if (map->slots) {
+        memset(map->slots, 0, sizeof(unsigned) * map->n_slots);
+    }
+    if (!self->parse_res[opt_idx].is_got) {
+        return CARGPARSE_DEFAULT_VALUE;
+    }
+
+    /* values of repeated options are not adjacent in argv: each one follows its own option token */
+    token = self->parse_res[opt_idx].valuestr;
+    for (got = 0; got < self->parse_res[opt_idx].nargs; got++) {
+        if (got > 0) {
+            do {
+                token++;
+            } while (!_cargparse_is_option_token(&self->options[opt_idx], token[-1]));
+        }
+        if ((ret = _cargparse_map_add_token(map, *token)) != CARGPARSE_OK) {
+            return ret;
+        }
+    }
+
+    return CARGPARSE_OK;
+}
+
+cargparse_err_e
+cargparse_get_map_long(const cargparse_t *const self, const char *long_name, cargparse_map_t *map) {
+    return _cargparse_get_map(self, CARGPARSE_NO_SHORT, long_name, map);
+}
+
+cargparse_err_e
+cargparse_get_map_short(const cargparse_t *const self, const char short_name, cargparse_map_t *map) {
+    return _cargparse_get_map(self, short_name, CARGPARSE_NO_LONG, map);
+}
+
+cargparse_err_e
+cargparse_map_find(const cargparse_map_t *const map, const char *key, cargparse_slice_t *value) {
+    unsigned slot, i;
+    size_t key_len;
+    const cargparse_kv_t *pair;
+
+    if (!map || !key) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (!value) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    key_len = strlen(key);
+    if (map->slots && map->n_pairs < map->n_slots) {
+        slot = _cargparse_hash(key, key_len) % map->n_slots;
+        while (map->slots[slot] != 0) {
+            pair = &map->pairs[map->slots[slot] - 1];
+            if (pair->key.len == key_len && memcmp(pair->key.str, key, key_len) == 0) {
+                *value = pair->value;
+                return CARGPARSE_OK;
+            }
+            slot = (slot + 1) % map->n_slots;
+        }
+        return CARGPARSE_MAP_KEY_NOT_FOUND;
+    }
+
+    for (i = map->n_pairs; i > 0; i--) {
+        pair = &map->pairs[i - 1];
+        if (pair->key.len == key_len && memcmp(pair->key.str, key, key_len) == 0) {
+            *value = pair->value;
+            return CARGPARSE_OK;
+        }
+    }
+    return CARGPARSE_MAP_KEY_NOT_FOUND;
+}
+
 static bool
 _cargparse_has_option(const cargparse_t *const self, const char short_name, const char *long_name) {
     int opt_idx = _cargparse_find_opt(self, short_name, long_name);
@@ -603,6 +2060,18 @@ cargparse_has_option_short(const cargparse_t *const self, const char short_name)
     return _cargparse_has_option(self, short_name, CARGPARSE_NO_LONG);
 }
 
+int
+cargparse_find_option_long(const cargparse_t *const self, const char *long_name) {
+    if (!self || long_name == CARGPARSE_NO_LONG) return -1;
+    return _cargparse_search_long_option(self, long_name);
+}
+
+int
+cargparse_find_option_short(const cargparse_t *const self, const char short_name) {
+    if (!self || short_name == CARGPARSE_NO_SHORT) return -1;
+    return _cargparse_search_short_option(self, short_name);
+}
+
 static cargparse_err_e
 _cargparse_get_arg_count(const cargparse_t *const self, const char short_name, const char *long_name,
                          unsigned *count) {
@@ -624,6 +2093,34 @@ _cargparse_get_arg_count(const cargparse_t *const self, const char short_name, c
     return CARGPARSE_OK;
 }
 
+static cargparse_err_e
+_cargparse_get_source(const cargparse_t *const self, const char short_name, const char *long_name,
+                      cargparse_source_e *source) {
+    int opt_idx;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!source) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    opt_idx = _cargparse_find_opt(self, short_name, long_name);
+    if (opt_idx == -1) {
+        *source = CARGPARSE_SOURCE_NONE;
+        return CARGPARSE_ERR_OPTION_UNKNOWN;
+    }
+    *source = self->parse_res[opt_idx].source;
+
+    return CARGPARSE_OK;
+}
+
+cargparse_err_e
+cargparse_get_source_long(const cargparse_t *const self, const char *long_name, cargparse_source_e *source) {
+    return _cargparse_get_source(self, CARGPARSE_NO_SHORT, long_name, source);
+}
+
+cargparse_err_e
+cargparse_get_source_short(const cargparse_t *const self, const char short_name, cargparse_source_e *source) {
+    return _cargparse_get_source(self, short_name, CARGPARSE_NO_LONG, source);
+}
+
 cargparse_err_e
 cargparse_get_arg_count_long(const cargparse_t *const self, const char *long_name, unsigned *count) {
     return _cargparse_get_arg_count(self, CARGPARSE_NO_SHORT, long_name, count);
@@ -633,3 +2130,709 @@ cargparse_err_e
 cargparse_get_arg_count_short(const cargparse_t *const self, const char short_name, unsigned *count) {
     return _cargparse_get_arg_count(self, short_name, CARGPARSE_NO_LONG, count);
 }
+
+struct cargparse_snapshot {
+    cargparse_t parser;
+};
+
+static cargparse_snapshot_t *
+_cargparse_snapshot_build(const cargparse_reloader_t *const self, cargparse_err_e *ret) {
+    cargparse_snapshot_t *snapshot;
+
+    snapshot = malloc(sizeof(cargparse_snapshot_t) + sizeof(cargparse_parse_res_t) * self->spec->n_options);
+    if (!snapshot) {
+        _cargparse_set_err_msg("Out of memory", NULL);
+        *ret = CARGPARSE_ERR_NO_MEMORY;
+        return NULL;
+    }
+    /* the spec's index is built before the first snapshot and only read afterwards */
+    memcpy(&snapshot->parser, self->spec, sizeof(cargparse_t));
+    snapshot->parser.parse_res = (cargparse_parse_res_t *)(snapshot + 1);
+    snapshot->parser.config_map = NULL;
+    snapshot->parser.config_size = 0;
+    snapshot->parser.events = NULL;
+    snapshot->parser.lazy = NULL;
+    snapshot->parser.trace = NULL; /* read from reader threads */
+    memset(snapshot->parser.parse_res, 0, sizeof(cargparse_parse_res_t) * self->spec->n_options);
+
+    if (self->config_path &&
+        (*ret = cargparse_load_config(&snapshot->parser, self->config_path)) != CARGPARSE_OK) {
+        cargparse_unload_config(&snapshot->parser);
+        free(snapshot);
+        return NULL;
+    }
+    *ret = cargparse_parse(&snapshot->parser, self->argc, self->argv);
+    if (*ret != CARGPARSE_OK && *ret != CARGPARSE_GOT_ZERO_ARGS) {
+        cargparse_unload_config(&snapshot->parser);
+        free(snapshot);
+        return NULL;
+    }
+    *ret = CARGPARSE_OK;
+    return snapshot;
+}
+
+static void
+_cargparse_snapshot_free(cargparse_snapshot_t *snapshot) {
+    cargparse_unload_config(&snapshot->parser);
+    free(snapshot);
+}
+
+cargparse_err_e
+cargparse_reloader_init(cargparse_reloader_t *const self, cargparse_t *const spec, const int argc,
+                        char **argv, const char *config_path) {
+    cargparse_err_e ret;
+
+    if (!self) return CARGPARSE_ERR_NULL_OUTPUT;
+    if (!spec) return CARGPARSE_ERR_NULL_PARSER;
+    if (!argv) return CARGPARSE_ERR_NULL_ARGUMENT;
+
+    memset(self, 0, sizeof(*self));
+    self->spec = spec;
+    self->argc = argc;
+    self->argv = argv;
+    self->config_path = config_path;
+    self->epoch = 1;
+
+    cargparse_prepare(spec);
+    if (!(self->current = _cargparse_snapshot_build(self, &ret))) {
+        return ret;
+    }
+    return CARGPARSE_OK;
+}
+
+cargparse_err_e
+cargparse_reloader_reload(cargparse_reloader_t *const self) {
+    int i;
+    unsigned long epoch, reader_epoch;
+    cargparse_snapshot_t *snapshot, *old;
+    cargparse_err_e ret;
+
+    if (!self || !self->spec) return CARGPARSE_ERR_NULL_PARSER;
+
+    if (!(snapshot = _cargparse_snapshot_build(self, &ret))) {
+        return ret;
+    }
+    old = __atomic_exchange_n(&self->current, snapshot, __ATOMIC_SEQ_CST);
+    epoch = __atomic_add_fetch(&self->epoch, 1, __ATOMIC_SEQ_CST);
+
+    /* grace period: a reader that entered before the swap has published an older epoch */
+    for (i = 0; i < CARGPARSE_MAX_READERS; i++) {
+        while ((reader_epoch = __atomic_load_n(&self->reader_epochs[i], __ATOMIC_SEQ_CST)) != 0 &&
+               reader_epoch < epoch) {
+            sched_yield();
+        }
+    }
+    _cargparse_snapshot_free(old);
+
+    return CARGPARSE_OK;
+}
+
+void
+cargparse_reloader_destroy(cargparse_reloader_t *const self) {
+    if (!self || !self->current) return;
+    _cargparse_snapshot_free(self->current);
+    self->current = NULL;
+}
+
+cargparse_err_e
+cargparse_reader_register(cargparse_reloader_t *const reloader, cargparse_reader_t *const reader) {
+    int i, expected;
+
+    if (!reloader) return CARGPARSE_ERR_NULL_PARSER;
+    if (!reader) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    for (i = 0; i < CARGPARSE_MAX_READERS; i++) {
+        expected = 0;
+        if (__atomic_compare_exchange_n(&reloader->reader_used[i], &expected, 1, false, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_RELAXED)) {
+            reader->reloader = reloader;
+            reader->slot = i;
+            return CARGPARSE_OK;
+        }
+    }
+    _cargparse_set_err_msg("All reader slots are taken", NULL);
+    return CARGPARSE_ERR_TOO_MANY_READERS;
+}
+
+void
+cargparse_reader_unregister(cargparse_reader_t *const reader) {
+    if (!reader || !reader->reloader) return;
+    __atomic_store_n(&reader->reloader->reader_epochs[reader->slot], 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&reader->reloader->reader_used[reader->slot], 0, __ATOMIC_RELEASE);
+    reader->reloader = NULL;
+}
+
+const cargparse_t *
+cargparse_reader_enter(cargparse_reader_t *const reader) {
+    unsigned long epoch;
+    cargparse_reloader_t *reloader = reader->reloader;
+
+    epoch = __atomic_load_n(&reloader->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&reloader->reader_epochs[reader->slot], epoch, __ATOMIC_SEQ_CST);
+    return &__atomic_load_n(&reloader->current, __ATOMIC_SEQ_CST)->parser;
+}
+
+void
+cargparse_reader_leave(cargparse_reader_t *const reader) {
+    __atomic_store_n(&reader->reloader->reader_epochs[reader->slot], 0, __ATOMIC_RELEASE);
+}
+
+#define CARGPARSE_BLOB_MAGIC 0x53504143U /* "CAPS" */
+#define CARGPARSE_BLOB_VERSION 1U
+
+#define CARGPARSE_BLOB_IS_GOT (1U << 0)
+#define CARGPARSE_BLOB_HAS_VALUES (1U << 1)
+
+/* All offsets are from the start of the blob, so it can be mapped anywhere. Laid out as the header, one
+ * record per option, `n_ptrs` string offsets (the tokens each option's valuestr spans, in option order)
+ * and the NUL-terminated strings. */
+typedef struct {
+    unsigned magic;
+    unsigned version;
+    unsigned fingerprint;
+    unsigned n_options;
+    unsigned n_ptrs;
+    unsigned size;
+} _cargparse_blob_header_t;
+
+typedef struct {
+    unsigned flags;
+    unsigned source;
+    int nargs;
+    unsigned n_tokens;
+} _cargparse_blob_record_t;
+
+/* Hash of everything in the spec that decides how values are resolved, help texts are left out */
+static unsigned
+_cargparse_spec_fingerprint(const cargparse_t *const self) {
+    int i, fields[4];
+    unsigned hash = CARGPARSE_HASH_BASIS;
+    const cargparse_option_t *opt;
+
+    hash = _cargparse_hash_update(hash, (const char *)&self->n_options, sizeof(self->n_options));
+    for (i = 0; i < self->n_options; i++) {
+        opt = &self->options[i];
+        fields[0] = opt->type;
+        fields[1] = opt->short_name;
+        fields[2] = opt->flags;
+        fields[3] = opt->nargs;
+        hash = _cargparse_hash_update(hash, (const char *)fields, sizeof(fields));
+        if (opt->long_name) {
+            hash = _cargparse_hash_update(hash, opt->long_name, strlen(opt->long_name) + 1);
+        } else {
+            hash = _cargparse_hash_update(hash, "", 1);
+        }
+    }
+    return hash;
+}
+
+/* Number of tokens from the first value to the last one, repeated MAP values are apart in argv */
+static unsigned
+_cargparse_value_span(const cargparse_t *const self, const int opt_idx) {
+    int got;
+    char **token;
+    const cargparse_parse_res_t *parse_res = &self->parse_res[opt_idx];
+
+    if (!parse_res->valuestr || parse_res->nargs <= 0) return 0;
+    if (self->options[opt_idx].type != CARGPARSE_OPTION_TYPE_MAP) return parse_res->nargs;
+
+    token = parse_res->valuestr;
+    for (got = 1; got < parse_res->nargs; got++) {
+        do {
+            token++;
+        } while (!_cargparse_is_option_token(&self->options[opt_idx], token[-1]));
+    }
+    return token - parse_res->valuestr + 1;
+}
+
+cargparse_err_e
+cargparse_blob_write(const cargparse_t *const self, void *buf, const size_t buf_size, size_t *blob_size) {
+    int i;
+    unsigned j, n_tokens, n_ptrs = 0, *offsets;
+    size_t size, len;
+    char *strings;
+    _cargparse_blob_header_t *header;
+    _cargparse_blob_record_t *record;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!blob_size) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    size = sizeof(_cargparse_blob_header_t) + sizeof(_cargparse_blob_record_t) * self->n_options;
+    for (i = 0; i < self->n_options; i++) {
+        n_tokens = _cargparse_value_span(self, i);
+        n_ptrs += n_tokens;
+        for (j = 0; j < n_tokens; j++) {
+            size += sizeof(unsigned) + strlen(self->parse_res[i].valuestr[j]) + 1;
+        }
+    }
+    *blob_size = size;
+    if (size > (unsigned)-1) {
+        _cargparse_set_err_msg("Parse results too large to serialize", NULL);
+        return CARGPARSE_ERR_INVALID_VALUE;
+    }
+    if (!buf || buf_size < size) return CARGPARSE_ERR_BUFFER_TOO_SMALL;
+
+    header = buf;
+    header->magic = CARGPARSE_BLOB_MAGIC;
+    header->version = CARGPARSE_BLOB_VERSION;
+    header->fingerprint = _cargparse_spec_fingerprint(self);
+    header->n_options = self->n_options;
+    header->n_ptrs = n_ptrs;
+    header->size = size;
+
+    record = (_cargparse_blob_record_t *)(header + 1);
+    offsets = (unsigned *)(record + self->n_options);
+    strings = (char *)(offsets + n_ptrs);
+    for (i = 0; i < self->n_options; i++, record++) {
+        n_tokens = _cargparse_value_span(self, i);
+        record->flags = (self->parse_res[i].is_got ? CARGPARSE_BLOB_IS_GOT : 0) |
+                        (self->parse_res[i].valuestr ? CARGPARSE_BLOB_HAS_VALUES : 0);
+        record->source = self->parse_res[i].source;
+        record->nargs = self->parse_res[i].nargs;
+        record->n_tokens = n_tokens;
+        for (j = 0; j < n_tokens; j++) {
+            len = strlen(self->parse_res[i].valuestr[j]) + 1;
+            memcpy(strings, self->parse_res[i].valuestr[j], len);
+            *offsets++ = strings - (char *)buf;
+            strings += len;
+        }
+    }
+
+    return CARGPARSE_OK;
+}
+
+static const _cargparse_blob_header_t *
+_cargparse_blob_header(const void *blob, const size_t size) {
+    size_t records_size;
+    const _cargparse_blob_header_t *header = blob;
+
+    if (!blob || (size_t)blob % sizeof(unsigned) != 0 || size < sizeof(*header)) return NULL;
+    if (header->magic != CARGPARSE_BLOB_MAGIC || header->version != CARGPARSE_BLOB_VERSION) return NULL;
+    if (header->size > size) return NULL;
+
+    records_size = sizeof(_cargparse_blob_record_t) * (size_t)header->n_options;
+    if (records_size > header->size - sizeof(*header)) return NULL;
+    if (header->n_ptrs > (header->size - sizeof(*header) - records_size) / sizeof(unsigned)) return NULL;
+    return header;
+}
+
+cargparse_err_e
+cargparse_blob_ptr_count(const void *blob, const size_t size, unsigned *n_ptrs) {
+    const _cargparse_blob_header_t *header;
+
+    if (!n_ptrs) return CARGPARSE_ERR_NULL_OUTPUT;
+    if (!(header = _cargparse_blob_header(blob, size))) {
+        _cargparse_set_err_msg("Not a parse result blob", NULL);
+        return CARGPARSE_ERR_BLOB_INVALID;
+    }
+    *n_ptrs = header->n_ptrs;
+    return CARGPARSE_OK;
+}
+
+/* Whether the getters stay within the tokens of `record`, loaded into `tokens`. MAP values are found the way
+ * _cargparse_value_span counts them: each one follows an option token, the last one ends the span. */
+static bool
+_cargparse_blob_record_is_valid(const cargparse_t *const self, const int opt_idx,
+                                const _cargparse_blob_record_t *record, char **tokens) {
+    unsigned j, n_values;
+    const cargparse_option_t *opt = &self->options[opt_idx];
+
+    if (record->nargs < 0) return false;
+    if (!(record->flags & CARGPARSE_BLOB_HAS_VALUES)) {
+        return record->n_tokens == 0 && (opt->type == CARGPARSE_OPTION_TYPE_BOOL || record->nargs == 0);
+    }
+    if (record->n_tokens == 0) return false;
+    if (opt->type != CARGPARSE_OPTION_TYPE_MAP) return (unsigned)record->nargs <= record->n_tokens;
+
+    for (n_values = 1, j = 1; j < record->n_tokens; j++) {
+        if (_cargparse_is_option_token(opt, tokens[j - 1])) n_values++;
+    }
+    return n_values == (unsigned)record->nargs &&
+           (record->n_tokens == 1 || _cargparse_is_option_token(opt, tokens[record->n_tokens - 2]));
+}
+
+cargparse_err_e
+cargparse_blob_load(cargparse_t *const self, const void *blob, const size_t size, char **ptrs,
+                    const unsigned n_ptrs) {
+    int i;
+    unsigned j, used = 0, strings_start;
+    const unsigned *offsets;
+    const char *data = blob;
+    const _cargparse_blob_header_t *header;
+    const _cargparse_blob_record_t *record;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!(header = _cargparse_blob_header(blob, size))) {
+        _cargparse_set_err_msg("Not a parse result blob", NULL);
+        return CARGPARSE_ERR_BLOB_INVALID;
+    }
+    if (header->n_options != (unsigned)self->n_options ||
+        header->fingerprint != _cargparse_spec_fingerprint(self)) {
+        _cargparse_set_err_msg("Blob was written for another spec", NULL);
+        return CARGPARSE_ERR_BLOB_MISMATCH;
+    }
+    if (n_ptrs < header->n_ptrs) return CARGPARSE_ERR_BUFFER_TOO_SMALL;
+    if (!ptrs && header->n_ptrs > 0) return CARGPARSE_ERR_NULL_ARGUMENT;
+
+    record = (const _cargparse_blob_record_t *)(header + 1);
+    offsets = (const unsigned *)(record + header->n_options);
+    strings_start = (const char *)(offsets + header->n_ptrs) - data;
+    if (header->n_ptrs > 0 && data[header->size - 1] != '\0') {
+        _cargparse_set_err_msg("Truncated parse result blob", NULL);
+        return CARGPARSE_ERR_BLOB_INVALID;
+    }
+    for (j = 0; j < header->n_ptrs; j++) {
+        if (offsets[j] < strings_start || offsets[j] >= header->size) {
+            _cargparse_set_err_msg("Corrupted parse result blob", NULL);
+            return CARGPARSE_ERR_BLOB_INVALID;
+        }
+    }
+
+    memset(self->parse_res, 0, sizeof(cargparse_parse_res_t) * self->n_options);
+    for (i = 0; i < self->n_options; i++, record++) {
+        if (record->n_tokens > header->n_ptrs - used) {
+            memset(self->parse_res, 0, sizeof(cargparse_parse_res_t) * self->n_options);
+            _cargparse_set_err_msg("Corrupted parse result blob", NULL);
+            return CARGPARSE_ERR_BLOB_INVALID;
+        }
+        self->parse_res[i].is_got = (record->flags & CARGPARSE_BLOB_IS_GOT) != 0;
+        self->parse_res[i].source = (cargparse_source_e)record->source;
+        self->parse_res[i].nargs = record->nargs;
+        if (record->flags & CARGPARSE_BLOB_HAS_VALUES) {
+            self->parse_res[i].valuestr = ptrs + used;
+        }
+        for (j = 0; j < record->n_tokens; j++) {
+            /* the blob may be mapped read-only, nothing writes through valuestr */
+            ptrs[used + j] = (char *)data + offsets[used + j];
+        }
+        if (!_cargparse_blob_record_is_valid(self, i, record, ptrs + used)) {
+            memset(self->parse_res, 0, sizeof(cargparse_parse_res_t) * self->n_options);
+            _cargparse_set_err_msg("Corrupted parse result blob", NULL);
+            return CARGPARSE_ERR_BLOB_INVALID;
+        }
+        used += record->n_tokens;
+    }
+
+    return CARGPARSE_OK;
+}
+
+typedef struct {
+    char **argv; /* NULL while measuring */
+    char *strings;
+    int argc;
+    size_t strings_size;
+} _cargparse_emit_state_t;
+
+static void
+_cargparse_emit_token(_cargparse_emit_state_t *state, const char *prefix, const char *token) {
+    size_t prefix_len = strlen(prefix), len = strlen(token) + 1;
+
+    if (state->argv) {
+        state->argv[state->argc] = state->strings + state->strings_size;
+        memcpy(state->argv[state->argc], prefix, prefix_len);
+        memcpy(state->argv[state->argc] + prefix_len, token, len);
+    }
+    state->argc++;
+    state->strings_size += prefix_len + len;
+}
+
+static void
+_cargparse_emit_option(_cargparse_emit_state_t *state, const cargparse_option_t *opt,
+                       const cargparse_parse_res_t *parse_res) {
+    int got;
+    char **token = parse_res->valuestr, short_name[2] = {0};
+    const char *prefix = "--", *name = opt->long_name;
+
+    if (opt->type != CARGPARSE_OPTION_TYPE_POS && !name) {
+        prefix = "-";
+        short_name[0] = opt->short_name;
+        name = short_name;
+    }
+
+    if (opt->type == CARGPARSE_OPTION_TYPE_BOOL) {
+        _cargparse_emit_token(state, prefix, name);
+        return;
+    }
+    if (opt->type != CARGPARSE_OPTION_TYPE_POS &&
+        (opt->type != CARGPARSE_OPTION_TYPE_MAP || parse_res->nargs == 0)) {
+        _cargparse_emit_token(state, prefix, name);
+    }
+    for (got = 0; got < parse_res->nargs; got++) {
+        if (opt->type == CARGPARSE_OPTION_TYPE_MAP) {
+            /* one occurrence per value, they are apart in argv */
+            if (got > 0) {
+                do {
+                    token++;
+                } while (!_cargparse_is_option_token(opt, token[-1]));
+            }
+            _cargparse_emit_token(state, prefix, name);
+            _cargparse_emit_token(state, "", *token);
+        } else {
+            _cargparse_emit_token(state, "", token[got]);
+        }
+    }
+}
+
+/* Options first, then positionals after "--" so values starting with '-' stay positional. The separator
+ * also ends a trailing variadic option. */
+static void
+_cargparse_emit_all(const cargparse_t *const self, const char *program, cargparse_emit_filter_f filter,
+                    void *ctx, const int flags, _cargparse_emit_state_t *state) {
+    int pass, i, nargs;
+    bool is_pos, is_variadic = false, is_separated = false;
+    const cargparse_parse_res_t *parse_res;
+
+    if (program) _cargparse_emit_token(state, "", program);
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < self->n_options; i++) {
+            parse_res = &self->parse_res[i];
+            is_pos = self->options[i].type == CARGPARSE_OPTION_TYPE_POS;
+            if (is_pos != (pass == 1) || !parse_res->is_got) continue;
+            if (parse_res->source != CARGPARSE_SOURCE_ARGV && !(flags & CARGPARSE_EMIT_RESOLVED)) continue;
+            if (filter && !filter(&self->options[i], ctx)) continue;
+
+            if (is_pos && !is_separated) {
+                _cargparse_emit_token(state, "", "--");
+                is_separated = true;
+            }
+            _cargparse_emit_option(state, &self->options[i], parse_res);
+            nargs = self->options[i].nargs;
+            is_variadic = nargs == CARGPARSE_NARGS_ONE_OR_MORE || nargs == CARGPARSE_NARGS_ZERO_OR_MORE;
+        }
+        if (pass == 0 && is_variadic) {
+            _cargparse_emit_token(state, "", "--");
+            is_separated = true;
+        }
+    }
+}
+
+cargparse_err_e
+cargparse_emit_argv(const cargparse_t *const self, const char *program, cargparse_emit_filter_f filter,
+                    void *ctx, const int flags, cargparse_argv_buf_t *out) {
+    size_t ptrs_size;
+    _cargparse_emit_state_t state = {NULL, NULL, 0, 0};
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!out) return CARGPARSE_ERR_NULL_OUTPUT;
+
+    _cargparse_emit_all(self, program, filter, ctx, flags, &state);
+    ptrs_size = sizeof(char *) * (state.argc + 1);
+    out->size = ptrs_size + state.strings_size;
+    out->argv = NULL;
+    out->argc = 0;
+    if (!out->buf || out->buf_size < out->size) return CARGPARSE_ERR_BUFFER_TOO_SMALL;
+
+    state.argv = out->buf;
+    state.strings = (char *)out->buf + ptrs_size;
+    state.argc = 0;
+    state.strings_size = 0;
+    _cargparse_emit_all(self, program, filter, ctx, flags, &state);
+    state.argv[state.argc] = NULL;
+
+    out->argv = state.argv;
+    out->argc = state.argc;
+    return CARGPARSE_OK;
+}
+
+static int
+_cargparse_complete_cmp(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* `word` starts with '-'. Grouped short flags ("-vx") are not completed. */
+static void
+_cargparse_complete_options(const cargparse_t *const self, const char *word, _cargparse_emit_state_t *state) {
+    int i;
+    char short_name[2] = {0};
+    size_t len = word[1] == '-' ? strlen(word + 2) : 0;
+    const cargparse_option_t *opt;
+
+    for (i = 0; i < self->n_options; i++) {
+        opt = &self->options[i];
+        if (opt->type == CARGPARSE_OPTION_TYPE_POS) continue;
+        if (opt->short_name != CARGPARSE_NO_SHORT &&
+            (word[1] == '\0' || (word[1] == opt->short_name && word[2] == '\0'))) {
+            short_name[0] = opt->short_name;
+            _cargparse_emit_token(state, "-", short_name);
+        }
+        if (opt->long_name &&
+            (word[1] == '\0' || (word[1] == '-' && strncmp(opt->long_name, word + 2, len) == 0))) {
+            _cargparse_emit_token(state, "--", opt->long_name);
+        }
+    }
+}
+
+static void
+_cargparse_complete_all(cargparse_command_t *const root, const int argc, char **argv, const int cursor,
+                        _cargparse_emit_state_t *state) {
+    int i;
+    unsigned j;
+    size_t len;
+    const char *word = cursor < argc ? argv[cursor] : "";
+    cargparse_command_t *cmd = root, *sub;
+
+    for (i = 1; i < cursor && cmd->n_subcommands > 0; i++) {
+        if (!(sub = _cargparse_command_find(cmd, argv[i]))) break;
+        cmd = sub;
+    }
+
+    if (word[0] != '-') {
+        if (i < cursor) return;
+        len = strlen(word);
+        for (j = 0; j < cmd->n_subcommands; j++) {
+            if (strncmp(cmd->subcommands[j].name, word, len) == 0) {
+                _cargparse_emit_token(state, "", cmd->subcommands[j].name);
+            }
+        }
+        return;
+    }
+    if (!cmd->parser) return;
+    for (; i < cursor; i++) {
+        if (strcmp(argv[i], "--") == 0) return;
+    }
+    _cargparse_complete_options(cmd->parser, word, state);
+}
+
+cargparse_err_e
+cargparse_complete_command(cargparse_command_t *const root, const int argc, char **argv, const int cursor,
+                           cargparse_argv_buf_t *out) {
+    size_t ptrs_size;
+    _cargparse_emit_state_t state = {NULL, NULL, 0, 0};
+
+    if (!root) return CARGPARSE_ERR_NULL_PARSER;
+    if (!argv) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (!out) return CARGPARSE_ERR_NULL_OUTPUT;
+    if (cursor < 0 || cursor > argc) {
+        _cargparse_set_err_msg("Completion cursor out of the command line", NULL);
+        return CARGPARSE_ERR_INVALID_VALUE;
+    }
+
+    _cargparse_complete_all(root, argc, argv, cursor, &state);
+    ptrs_size = sizeof(char *) * (state.argc + 1);
+    out->size = ptrs_size + state.strings_size;
+    out->argv = NULL;
+    out->argc = 0;
+    if (!out->buf || out->buf_size < out->size) return CARGPARSE_ERR_BUFFER_TOO_SMALL;
+
+    state.argv = out->buf;
+    state.strings = (char *)out->buf + ptrs_size;
+    state.argc = 0;
+    state.strings_size = 0;
+    _cargparse_complete_all(root, argc, argv, cursor, &state);
+    qsort(state.argv, (size_t)state.argc, sizeof(char *), _cargparse_complete_cmp);
+    state.argv[state.argc] = NULL;
+
+    out->argv = state.argv;
+    out->argc = state.argc;
+    return CARGPARSE_OK;
+}
+
+cargparse_err_e
+cargparse_complete(const cargparse_t *const self, const int argc, char **argv, const int cursor,
+                   cargparse_argv_buf_t *out) {
+    /* a node without subcommands never writes through its parser */
+    cargparse_command_t node = {NULL, NULL, NULL, 0, NULL, 0, false};
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    node.parser = (cargparse_t *)self;
+    return cargparse_complete_command(&node, argc, argv, cursor, out);
+}
+
+bool
+cargparse_handle_completion(cargparse_command_t *const root, const int argc, char **argv) {
+    int i;
+    long cursor;
+    char stack_buf[CARGPARSE_HELP_STACK_SIZE], *end;
+    cargparse_argv_buf_t out;
+    cargparse_err_e ret;
+
+    if (argc < 3 || strcmp(argv[1], CARGPARSE_COMPLETE_COMMAND) != 0) return false;
+    cursor = strtol(argv[2], &end, 10);
+    if (*end != '\0' || cursor < 0 || cursor > argc - 3) return true;
+
+    out.buf = stack_buf;
+    out.buf_size = sizeof(stack_buf);
+    ret = cargparse_complete_command(root, argc - 3, argv + 3, (int)cursor, &out);
+    if (ret == CARGPARSE_ERR_BUFFER_TOO_SMALL) {
+        out.buf_size = out.size;
+        if (!(out.buf = malloc(out.buf_size))) return true;
+        ret = cargparse_complete_command(root, argc - 3, argv + 3, (int)cursor, &out);
+    }
+    for (i = 0; ret == CARGPARSE_OK && i < out.argc; i++) {
+        fputs(out.argv[i], stdout);
+        fputc('\n', stdout);
+    }
+    fflush(stdout);
+    if (out.buf != stack_buf) free(out.buf);
+    return true;
+}
+
+/* \1 stands for the program, \2 for its completion function */
+static const char *const CARGPARSE_COMPLETION_SCRIPTS[] = {
+    "\2() {\n"
+    "    local IFS=$'\\n'\n"
+    "    COMPREPLY=($(\"${COMP_WORDS[0]}\" " CARGPARSE_COMPLETE_COMMAND
+    " \"$COMP_CWORD\" \"${COMP_WORDS[@]}\" 2>/dev/null))\n"
+    "}\n"
+    "complete -o default -F \2 \1\n",
+
+    "#compdef \1\n"
+    "\2() {\n"
+    "    local -a candidates\n"
+    "    candidates=(\"${(@f)$(\"${words[1]}\" " CARGPARSE_COMPLETE_COMMAND
+    " $((CURRENT - 1)) \"${words[@]}\" 2>/dev/null)}\")\n"
+    "    if [[ -n \"${candidates[1]}\" ]]; then\n"
+    "        compadd -a candidates\n"
+    "    else\n"
+    "        _files\n"
+    "    fi\n"
+    "}\n"
+    "compdef \2 \1\n",
+
+    "complete -c \1 -a '(\1 " CARGPARSE_COMPLETE_COMMAND
+    " (count (commandline -opc)) (commandline -opc) (commandline -ct))'\n",
+};
+
+cargparse_err_e
+cargparse_completion_script(const cargparse_shell_e shell, const char *program, char *buf,
+                            const size_t buf_size, size_t *script_size) {
+    size_t i, len;
+    const char *ch;
+    _cargparse_help_state_t state;
+
+    if (!program) return CARGPARSE_ERR_NULL_ARGUMENT;
+    if (!script_size) return CARGPARSE_ERR_NULL_OUTPUT;
+    if ((unsigned)shell > CARGPARSE_SHELL_FISH) {
+        _cargparse_set_err_msg("Unknown shell", NULL);
+        return CARGPARSE_ERR_INVALID_VALUE;
+    }
+    len = strlen(program);
+    for (i = 0; i < len; i++) {
+        if (!isalnum((unsigned char)program[i]) && !strchr("._+-", program[i])) break;
+    }
+    if (len == 0 || i < len) {
+        _cargparse_set_err_msg("Program name not usable in a completion script", program);
+        return CARGPARSE_ERR_INVALID_VALUE;
+    }
+
+    state.buf = buf;
+    state.buf_size = buf_size;
+    state.size = 0;
+    for (ch = CARGPARSE_COMPLETION_SCRIPTS[shell]; *ch != '\0'; ch++) {
+        if (*ch == '\1') {
+            _cargparse_help_put(&state, program, len);
+        } else if (*ch == '\2') {
+            _cargparse_help_put(&state, "_cargparse_", 11);
+            for (i = 0; i < len; i++) {
+                _cargparse_help_put(&state, isalnum((unsigned char)program[i]) ? &program[i] : "_", 1);
+            }
+        } else {
+            _cargparse_help_put(&state, ch, 1);
+        }
+    }
+    *script_size = state.size + 1;
+    if (!buf || buf_size < *script_size) return CARGPARSE_ERR_BUFFER_TOO_SMALL;
+
+    buf[state.size] = '\0';
+    return CARGPARSE_OK;
+}
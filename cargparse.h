@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef enum {
     CARGPARSE_OPTION_TYPE_POS = 0,
@@ -13,11 +14,13 @@ typedef enum {
     CARGPARSE_OPTION_TYPE_INT,
     CARGPARSE_OPTION_TYPE_FLOAT,
     CARGPARSE_OPTION_TYPE_STR,
+    CARGPARSE_OPTION_TYPE_MAP,
 } cargparse_option_type_e;
 
 typedef enum {
     CARGPARSE_FLAG_NONE = 0,
     CARGPARSE_FLAG_REQUIRED = 1 << 0,
+    CARGPARSE_FLAG_ENV = 1 << 1, /* may be set by <env_prefix><LONG_NAME>, see cargparse_set_env_prefix */
 } cargparse_option_flag_e;
 
 typedef enum {
@@ -42,8 +45,36 @@ typedef enum {
     CARGPARSE_ERR_NARG_OUT_OF_RANGE,
     CARGPARSE_ZERO_NARGS,
     CARGPARSE_OPT_NOT_GOT,
+
+    CARGPARSE_ERR_MAP_FULL,
+    CARGPARSE_MAP_KEY_NOT_FOUND,
+
+    CARGPARSE_ERR_CONFIG_IO,
+    CARGPARSE_ERR_CONFIG_SYNTAX,
+
+    CARGPARSE_ERR_NO_MEMORY,
+    CARGPARSE_ERR_TOO_MANY_READERS,
+
+    CARGPARSE_ERR_SUBCOMMAND_UNKNOWN,
+    CARGPARSE_ERR_SUBCOMMAND_MISSING,
+
+    CARGPARSE_ERR_BUFFER_TOO_SMALL,
+    CARGPARSE_ERR_BLOB_INVALID,
+    CARGPARSE_ERR_BLOB_MISMATCH,
+
+    CARGPARSE_ERR_FROZEN,
+
+    CARGPARSE_ERR_LINE_SYNTAX,
 } cargparse_err_e;
 
+/* Where the value of an option came from, later sources override earlier ones */
+typedef enum {
+    CARGPARSE_SOURCE_NONE = 0,
+    CARGPARSE_SOURCE_FILE,
+    CARGPARSE_SOURCE_ENV,
+    CARGPARSE_SOURCE_ARGV,
+} cargparse_source_e;
+
 typedef struct {
     const cargparse_option_type_e type;
     const char short_name;
@@ -57,8 +88,69 @@ typedef struct {
     bool is_got;
     char **valuestr;
     int nargs;
+    char *value; /* holds a value not taken from argv, valuestr points here then */
+    cargparse_source_e source;
 } cargparse_parse_res_t;
 
+/* Packed copy of the option fields the parse loop reads for every token, 12 bytes against the 32 of
+ * cargparse_option_t, whose help and long name strings are then only touched to confirm a match */
+typedef struct {
+    unsigned hash; /* of the long name */
+    int nargs;
+    unsigned short flags;
+    unsigned char type;
+    unsigned char name_len; /* of the long name, 0 without one and 255 from there on */
+} cargparse_option_hot_t;
+
+/* Name lookup tables, built once by cargparse_prepare. The first CARGPARSE_INDEX_SHORT_SLOTS words map
+ * ASCII short names to option index + 1, the rest is an open-addressing hash table of long names
+ * storing option index + 1 (0 marks an empty slot). `hot` holds one record per option, without it the
+ * parser reads the options themselves. */
+typedef struct {
+    unsigned *words;
+    const unsigned n_words;
+    bool is_built;
+    cargparse_option_hot_t *hot;
+} cargparse_index_t;
+
+/* An option name or value taken from argv, see cargparse_set_event_log */
+typedef struct {
+    int opt_idx;   /* into the options of the parser */
+    int argv_idx;  /* of the token */
+    int value_idx; /* of the value as passed to the getters, -1 for the option name */
+} cargparse_event_t;
+
+/* Caller memory for the events of one parse. `n_events` counts every event of the last parse, those past
+ * `max_events` are not stored. */
+typedef struct {
+    cargparse_event_t *events;
+    unsigned n_events;
+    const unsigned max_events;
+} cargparse_event_log_t;
+
+/* Number converted from one argv entry, see cargparse_set_lazy */
+typedef struct {
+    union {
+        long i;
+        double f;
+    } value;
+    unsigned stamp; /* of the lazy state when converted, only valid numbers are kept */
+} cargparse_lazy_value_t;
+
+/* Caller memory for lazy conversion, `values` holds one entry per argv index below `max_values`. `argv`,
+ * `argc` and `stamp` are kept by the parser. */
+typedef struct {
+    cargparse_lazy_value_t *values;
+    const unsigned max_values;
+    char **argv;
+    int argc;
+    unsigned stamp;
+} cargparse_lazy_t;
+
+/* Instrumentation is compiled in only when CARGPARSE_TRACE is defined, see cargparse_set_trace. The
+ * `trace` member of cargparse_t exists either way, so traced and plain builds share one layout. */
+typedef struct cargparse_trace cargparse_trace_t;
+
 typedef struct {
     const char *usages;
     const char *description;
@@ -66,24 +158,173 @@ typedef struct {
     const cargparse_option_t *options;
     cargparse_parse_res_t *parse_res;
     const int n_options;
+    cargparse_index_t index;
+    const char *env_prefix;
+    char *config_map; /* private mapping of the loaded config file, values point into it */
+    size_t config_size;
+    cargparse_event_log_t *events; /* see cargparse_set_event_log */
+    cargparse_lazy_t *lazy;        /* see cargparse_set_lazy */
+    cargparse_trace_t *trace;      /* see cargparse_set_trace, NULL without CARGPARSE_TRACE */
 } cargparse_t;
 
+/* Growable spec for options registered at runtime. The index is kept current on every add and rehashed
+ * only when the capacity doubles; strings of added options must outlive the builder. */
+typedef struct {
+    const char *usages;
+    const char *description;
+    const char *epilog;
+    cargparse_option_t *options;
+    int n_options;
+    int max_options;
+    unsigned *words;
+    unsigned n_words;
+    cargparse_option_hot_t *hot;
+    cargparse_parse_res_t *parse_res; /* allocated by cargparse_builder_freeze, no adds afterwards */
+} cargparse_builder_t;
+
+/* Slice of argv memory, not NUL-terminated */
+typedef struct {
+    const char *str;
+    unsigned len;
+} cargparse_slice_t;
+
+typedef struct {
+    cargparse_slice_t key;
+    cargparse_slice_t value;
+} cargparse_kv_t;
+
+/* Caller-owned storage for the pairs of a MAP option. `slots` is an optional open-addressing table of
+ * pair indexes (+1) used by cargparse_map_find, NULL disables it and lookups fall back to a linear scan. */
+typedef struct {
+    cargparse_kv_t *pairs;
+    unsigned n_pairs;
+    const unsigned max_pairs;
+    unsigned *slots;
+    const unsigned n_slots;
+} cargparse_map_t;
+
+/* Which values cargparse_emit_argv writes */
+typedef enum {
+    CARGPARSE_EMIT_ARGV = 0,          /* only values given on the command line */
+    CARGPARSE_EMIT_RESOLVED = 1 << 0, /* also values resolved from the config file and the environment */
+} cargparse_emit_flag_e;
+
+/* Returns true for options to emit */
+typedef bool (*cargparse_emit_filter_f)(const cargparse_option_t *const opt, void *ctx);
+
+/* Caller memory for cargparse_emit_argv and cargparse_complete. The NULL-terminated vector and the strings
+ * it points to are both written into `buf`, `size` is set to the bytes they need. */
+typedef struct {
+    void *buf;
+    size_t buf_size;
+    size_t size;
+    char **argv;
+    int argc;
+} cargparse_argv_buf_t;
+
+/* argv[1] of the calls completion scripts make: `program __complete CWORD WORD...` */
+#define CARGPARSE_COMPLETE_COMMAND "__complete"
+
+typedef enum {
+    CARGPARSE_SHELL_BASH = 0,
+    CARGPARSE_SHELL_ZSH,
+    CARGPARSE_SHELL_FISH,
+} cargparse_shell_e;
+
+typedef struct cargparse_command cargparse_command_t;
+
+/* Node of a subcommand tree. `parser` is NULL for groups that only dispatch, `slots` is a hash table of
+ * subcommand index + 1 by name, built the first time the node dispatches. */
+struct cargparse_command {
+    const char *name;
+    cargparse_t *parser;
+    cargparse_command_t *subcommands;
+    const unsigned n_subcommands;
+    unsigned *slots;
+    const unsigned n_slots;
+    bool is_built;
+};
+
+/* An incremental parse between cargparse_parse_begin and cargparse_parse_finish */
+typedef struct {
+    cargparse_t *parser;
+    int n_tokens;          /* argv entries parsed so far, the program name included */
+    int opt_idx;           /* option taking the next values, -1 for none */
+    int last_pos_i;        /* positional taking the next positional values, -1 before the first */
+    int state;             /* what the next token may be, private */
+    cargparse_err_e error; /* first failure, returned again by every later call */
+} cargparse_stream_t;
+
+#define CARGPARSE_MAX_READERS 64
+
+typedef struct cargparse_snapshot cargparse_snapshot_t;
+
+/* Rebuilds immutable snapshots of a parser from a config file plus the original argv. Readers get the
+ * current snapshot through an atomic pointer and never block; a reload waits for readers still inside an
+ * older epoch before freeing the snapshot they may hold. Only one thread may reload at a time, and the
+ * config file should be replaced by rename rather than rewritten since live snapshots map it. */
+typedef struct {
+    cargparse_t *spec;
+    int argc;
+    char **argv;
+    const char *config_path;
+    cargparse_snapshot_t *current;
+    unsigned long epoch;
+    unsigned long reader_epochs[CARGPARSE_MAX_READERS]; /* 0 while the reader is outside */
+    int reader_used[CARGPARSE_MAX_READERS];
+} cargparse_reloader_t;
+
+typedef struct {
+    cargparse_reloader_t *reloader;
+    int slot;
+} cargparse_reader_t;
+
 #define CARGPARSE_NARGS_ONE_OR_MORE (-111)
 #define CARGPARSE_NARGS_ZERO_OR_MORE (-222)
 
 #define CARGPARSE_NO_SHORT (-1)
 #define CARGPARSE_NO_LONG (NULL)
 
+#define CARGPARSE_INDEX_SHORT_SLOTS 128
+#define CARGPARSE_INDEX_SIZE(_n_options) (CARGPARSE_INDEX_SHORT_SLOTS + 2 * (_n_options))
+
 #define CARGPARSE_INIT(_name, _usages, _description, _epilog, ...)                                          \
     const cargparse_option_t _##_name##_options[] = {__VA_ARGS__};                                          \
     cargparse_parse_res_t _##_name##_parse_res[sizeof(_##_name##_options) / sizeof(cargparse_option_t)] = { \
         0};                                                                                                 \
-    cargparse_t _name = {_usages,                                                                           \
-                         _description,                                                                      \
-                         _epilog,                                                                           \
-                         _##_name##_options,                                                                \
-                         _##_name##_parse_res,                                                              \
-                         sizeof(_##_name##_options) / sizeof(cargparse_option_t)};
+    unsigned                                                                                                \
+        _##_name##_index[CARGPARSE_INDEX_SIZE(sizeof(_##_name##_options) / sizeof(cargparse_option_t))];    \
+    cargparse_option_hot_t _##_name##_hot[sizeof(_##_name##_options) / sizeof(cargparse_option_t)];         \
+    cargparse_t _name = {                                                                                   \
+        _usages,                                                                                            \
+        _description,                                                                                       \
+        _epilog,                                                                                            \
+        _##_name##_options,                                                                                 \
+        _##_name##_parse_res,                                                                               \
+        sizeof(_##_name##_options) / sizeof(cargparse_option_t),                                            \
+        {_##_name##_index, sizeof(_##_name##_index) / sizeof(unsigned), false, _##_name##_hot},             \
+        NULL,                                                                                               \
+        NULL,                                                                                               \
+        0,                                                                                                  \
+        NULL,                                                                                               \
+        NULL,                                                                                               \
+        NULL};
+
+/* Array of sibling subcommands plus the storage for their name hash */
+#define CARGPARSE_COMMANDS(_name, ...)           \
+    cargparse_command_t _name[] = {__VA_ARGS__}; \
+    unsigned _##_name##_slots[2 * sizeof(_name) / sizeof(cargparse_command_t)];
+
+#define CARGPARSE_COMMAND(_cmd_name, _parser)        \
+    {                                                \
+        _cmd_name, _parser, NULL, 0, NULL, 0, false, \
+    }
+
+#define CARGPARSE_COMMAND_GROUP(_cmd_name, _parser, _subcommands)                                   \
+    {                                                                                               \
+        _cmd_name, _parser, _subcommands, sizeof(_subcommands) / sizeof(cargparse_command_t),       \
+            _##_subcommands##_slots, 2 * sizeof(_subcommands) / sizeof(cargparse_command_t), false, \
+    }
 
 #define CARGPARSE_OPTION_INIT(_type, _short_name, _long_name, _help, _flags, _nargs) \
     {                                                                                \
@@ -105,15 +346,272 @@ typedef struct {
 #define CARGPARSE_OPTION_POSITIONAL(_long_name, _help, _flags, _nargs) \
     CARGPARSE_OPTION_INIT(CARGPARSE_OPTION_TYPE_POS, CARGPARSE_NO_SHORT, _long_name, _help, _flags, _nargs)
 
+/* `-o key=val,key2=val2 -o key3=val3`, may be repeated */
+#define CARGPARSE_OPTION_MAP(_short_name, _long_name, _help, _flags) \
+    CARGPARSE_OPTION_INIT(CARGPARSE_OPTION_TYPE_MAP, _short_name, _long_name, _help, _flags, 1)
+
+#define CARGPARSE_MAP_INIT(_name, _max_pairs)                   \
+    cargparse_kv_t _##_name##_pairs[_max_pairs];                \
+    unsigned _##_name##_slots[2 * (_max_pairs)];                \
+    cargparse_map_t _name = {_##_name##_pairs, 0, (_max_pairs), \
+                             _##_name##_slots, 2 * (_max_pairs)};
+
+#define CARGPARSE_MAP_INIT_NO_HASH(_name, _max_pairs) \
+    cargparse_kv_t _##_name##_pairs[_max_pairs];      \
+    cargparse_map_t _name = {_##_name##_pairs, 0, (_max_pairs), NULL, 0};
+
+/* Renders the help into `buf` as one NUL-terminated string: the name column is as wide as the longest long
+ * name and help text is word-wrapped at `width` columns (0 for 80). The required size, NUL included, is
+ * always stored in `help_size`, a NULL or short `buf` gets CARGPARSE_ERR_BUFFER_TOO_SMALL. */
+cargparse_err_e
+cargparse_render_help(const cargparse_t *const self, const unsigned width, char *buf, const size_t buf_size,
+                      size_t *help_size);
+
+/* Renders at the terminal width (else $COLUMNS, else 80) and prints with a single write to stdout */
 void
 cargparse_print_help(const cargparse_t *const self);
 
+/* Builds the name index, called by cargparse_parse. Getters fall back to linear search until then. */
+void
+cargparse_prepare(cargparse_t *const self);
+
+void
+cargparse_builder_init(cargparse_builder_t *const self, const char *usages, const char *description,
+                       const char *epilog);
+
+/* Copies `opt` into the builder, names already taken are rejected with CARGPARSE_ERR_INVALID_OPTION */
+cargparse_err_e
+cargparse_builder_add(cargparse_builder_t *const self, const cargparse_option_t *const opt);
+
+/* Fills `parser` with the same compiled form as a CARGPARSE_INIT parser after cargparse_prepare. It
+ * points into the builder and is valid until cargparse_builder_destroy. */
+cargparse_err_e
+cargparse_builder_freeze(cargparse_builder_t *const self, cargparse_t *const parser);
+
+void
+cargparse_builder_destroy(cargparse_builder_t *const self);
+
+/* Options with CARGPARSE_FLAG_ENV not given in argv are taken from `<prefix><NAME>` environment variables,
+ * where NAME is the long name upper-cased with '-' replaced by '_'. NULL disables the lookup. A variable
+ * gives one value, so a set variable for an option with a fixed nargs > 1 fails the parse with
+ * CARGPARSE_ERR_INVALID_VALUE; variadic options get that single value. */
+void
+cargparse_set_env_prefix(cargparse_t *const self, const char *prefix);
+
+#ifdef CARGPARSE_TRACE
+typedef enum {
+    CARGPARSE_TRACE_TOKEN = 0, /* token classified, `detail` 0 value, 1 short, 2 long, 3 "--", -1 empty */
+    CARGPARSE_TRACE_MATCH,     /* option named in argv */
+    CARGPARSE_TRACE_CONVERT,   /* argument of a got option returned by a getter, `detail` is its index */
+    CARGPARSE_TRACE_ERROR,     /* cargparse_parse or a getter failed, `detail` is the cargparse_err_e */
+} cargparse_trace_event_e;
+
+typedef enum {
+    CARGPARSE_PHASE_PREPARE = 0, /* index build */
+    CARGPARSE_PHASE_ARGV,
+    CARGPARSE_PHASE_ENV,
+    CARGPARSE_PHASE_CHECK, /* required options */
+    CARGPARSE_PHASE_GET,   /* getter calls */
+    CARGPARSE_N_PHASES,
+} cargparse_phase_e;
+
+/* `opt_idx` is -1 and `arg` NULL where they do not apply */
+typedef void (*cargparse_trace_f)(const cargparse_t *const parser, const cargparse_trace_event_e event,
+                                  const int opt_idx, const char *arg, const int detail, void *ctx);
+
+/* Counters of one parser, accumulated over every cargparse_parse and getter call while attached */
+struct cargparse_trace {
+    cargparse_trace_f hook; /* NULL to only count */
+    void *ctx;
+    unsigned long tokens;
+    unsigned long lookups; /* option name searches from argv, the environment, config files and getters */
+    unsigned long conversions;
+    unsigned long errors;
+    unsigned long long ns[CARGPARSE_N_PHASES];
+    int phase; /* running cargparse_phase_e, -1 between calls */
+    unsigned long long phase_start;
+};
+
+/* Attaches `trace` with zeroed counters, NULL detaches. The counters and the running phase are updated
+ * outside of the hook without synchronization, so a parser with a trace attached must not be used from
+ * several threads at once; give each thread its own parser with cargparse_bind, which drops the trace. */
+void
+cargparse_set_trace(cargparse_t *const self, cargparse_trace_t *const trace, const cargparse_trace_f hook,
+                    void *ctx);
+#endif
+
+/* First error message of the last cargparse_parse, cargparse_parse_begin, cargparse_split_line or
+ * cargparse_load_config call in the calling thread, which clear it when they start. Errors of other calls,
+ * getters included, are added only while no message is set. */
 const char *
 cargparse_get_err_msg(void);
 
 cargparse_err_e
 cargparse_parse(cargparse_t *const self, const int argc, char **argv);
 
+/* Makes `self` a parser of `spec` with its own results in `parse_res` (one per option of `spec`), e.g. one
+ * per connection of a command server, so any number of them parse at once without allocating. They share
+ * the options, index and env prefix of `spec`, whose index is built by the first bind; bind once before
+ * sharing `spec` between threads. Results accumulate as with any parser, zero `parse_res` between parses,
+ * and point into the parsed argv, which must outlive them. */
+cargparse_err_e
+cargparse_bind(cargparse_t *const self, cargparse_t *const spec, cargparse_parse_res_t *parse_res);
+
+/* Splits a command line like `set --rate 1000 --name 'a b'` in place into the words of `argv`, followed by
+ * NULL, for cargparse_parse: the first word takes the place of the program name. Quoting is the shell's
+ * without expansions: blanks separate words, '...' is literal, and a backslash keeps the next character
+ * (between "..." only a double quote, backslash, '$' or '`'). The word count is always stored in `argc`;
+ * `max_args` must leave room for the NULL, else CARGPARSE_ERR_BUFFER_TOO_SMALL. An open quote or a trailing
+ * backslash gets CARGPARSE_ERR_LINE_SYNTAX. `line` is rewritten either way, a retry needs the original. */
+cargparse_err_e
+cargparse_split_line(char *line, char **argv, const int max_args, int *argc);
+
+/* Records into `log` an event for every option name and value the following parses take from argv, in argv
+ * order, so a program with a large spec visits only what was passed instead of querying every option. A
+ * cluster like -vq gives one event per option, values from the environment or a config file give none.
+ * NULL stops recording. A log that was too short for the last parse has `n_events` > `max_events`. */
+void
+cargparse_set_event_log(cargparse_t *const self, cargparse_event_log_t *const log);
+
+/* Stored event at `*cursor` (start at 0), which is advanced; NULL after the last one */
+const cargparse_event_t *
+cargparse_event_next(const cargparse_event_log_t *const log, unsigned *cursor);
+
+/* Makes the following parses only classify tokens, INT and FLOAT values are checked and converted by the
+ * first getter reading them and kept in `lazy` for later reads of the same argv entry. NULL restores the
+ * checks at parse time. The error contract changes accordingly:
+ * - cargparse_parse no longer fails on a malformed number, from argv, the environment or a config file
+ * - a getter reading one returns CARGPARSE_ERR_INVALID_VALUE on every read and leaves its result unset
+ * - values that are never read are never checked, cargparse_check_values checks them all at once
+ * Getters write to `lazy`, so a lazy parser must not be read from several threads. Entries past
+ * `max_values` and values from outside argv are converted on every read. */
+void
+cargparse_set_lazy(cargparse_t *const self, cargparse_lazy_t *const lazy);
+
+/* Checks every INT and FLOAT value of the last parse, as a parse without cargparse_set_lazy would have.
+ * Returns CARGPARSE_ERR_INVALID_VALUE for the first malformed one. */
+cargparse_err_e
+cargparse_check_values(const cargparse_t *const self);
+
+/* cargparse_parse for arguments that arrive piecewise: begin, feed the same argv each time it has grown
+ * (argv[0] is the program name), then finish. A feed parses only the entries after those already fed and
+ * keeps a pending option and the positional cursor for the next one. Values point into argv, so entries
+ * are only appended and stay in place. The pending option, environment and required options are checked
+ * by finish, which returns CARGPARSE_GOT_ZERO_ARGS when nothing was fed as cargparse_parse does. */
+cargparse_err_e
+cargparse_parse_begin(cargparse_stream_t *const stream, cargparse_t *const parser);
+
+cargparse_err_e
+cargparse_parse_feed(cargparse_stream_t *const stream, const int argc, char **argv);
+
+cargparse_err_e
+cargparse_parse_finish(cargparse_stream_t *const stream);
+
+/* Closest long option name to `long_name` (given without "--") by edit distance, as suggested in
+ * "Unknown option" messages, or NULL when no name is close enough. Does not allocate. */
+const char *
+cargparse_suggest_option(const cargparse_t *const self, const char *long_name);
+
+/* Follows leading command tokens down the tree (`tool db compact --level 3`) and parses the remaining
+ * arguments with the deepest matched command's parser only, which is stored in `selected`. */
+cargparse_err_e
+cargparse_parse_command(cargparse_command_t *const root, const int argc, char **argv,
+                        cargparse_command_t **selected);
+
+/* Busybox-style dispatch over the subcommands of `registry`: the applet is named by basename(argv[0]), or
+ * by argv[1] when the binary runs under another name. The applet then dispatches as in
+ * cargparse_parse_command. */
+cargparse_err_e
+cargparse_parse_multicall(cargparse_command_t *const registry, const int argc, char **argv,
+                          cargparse_command_t **selected);
+
+/* Loads `long-name = value` lines ('#' starts a comment) as defaults for a following cargparse_parse.
+ * The file is mapped privately and tokenized in place, values stay valid until cargparse_unload_config.
+ * A line gives one value, a key whose option has a fixed nargs > 1 gets CARGPARSE_ERR_INVALID_VALUE. */
+cargparse_err_e
+cargparse_load_config(cargparse_t *const self, const char *path);
+
+void
+cargparse_unload_config(cargparse_t *const self);
+
+/* `config_path` may be NULL, `argv` must outlive the reloader */
+cargparse_err_e
+cargparse_reloader_init(cargparse_reloader_t *const self, cargparse_t *const spec, const int argc,
+                        char **argv, const char *config_path);
+
+/* On failure the previous snapshot stays published */
+cargparse_err_e
+cargparse_reloader_reload(cargparse_reloader_t *const self);
+
+/* No reader may be inside a snapshot */
+void
+cargparse_reloader_destroy(cargparse_reloader_t *const self);
+
+cargparse_err_e
+cargparse_reader_register(cargparse_reloader_t *const reloader, cargparse_reader_t *const reader);
+
+void
+cargparse_reader_unregister(cargparse_reader_t *const reader);
+
+/* The returned parser is read-only and valid until cargparse_reader_leave; enter/leave do not nest */
+const cargparse_t *
+cargparse_reader_enter(cargparse_reader_t *const reader);
+
+void
+cargparse_reader_leave(cargparse_reader_t *const reader);
+
+/* Serializes the resolved values of a parsed spec, with a fingerprint of the spec, into a
+ * position-independent blob in native byte order (meant for a memfd or shared mapping between processes
+ * of one host). The required size is always stored in `blob_size`, a NULL or short `buf` gets
+ * CARGPARSE_ERR_BUFFER_TOO_SMALL. */
+cargparse_err_e
+cargparse_blob_write(const cargparse_t *const self, void *buf, const size_t buf_size, size_t *blob_size);
+
+/* Number of `ptrs` cargparse_blob_load needs for this blob */
+cargparse_err_e
+cargparse_blob_ptr_count(const void *blob, const size_t size, unsigned *n_ptrs);
+
+/* Fills the parse results of `self` from a blob written for the same spec, without parsing or copying:
+ * values point into the blob through `ptrs`, and both must outlive the results. The blob must be aligned
+ * to an unsigned, which any mapping is. */
+cargparse_err_e
+cargparse_blob_load(cargparse_t *const self, const void *blob, const size_t size, char **ptrs,
+                    const unsigned n_ptrs);
+
+/* Rebuilds a normalized argv from parse results: `program` (if not NULL), options in spec order under their
+ * long name (short name when there is none) with each repeated MAP value under its own option, then "--"
+ * and the positionals. `filter` may be NULL to keep all options. A NULL or short `out->buf` gets
+ * CARGPARSE_ERR_BUFFER_TOO_SMALL with `out->size` set, so one allocation is enough. */
+cargparse_err_e
+cargparse_emit_argv(const cargparse_t *const self, const char *program, cargparse_emit_filter_f filter,
+                    void *ctx, const int flags, cargparse_argv_buf_t *out);
+
+/* Completion candidates for word `cursor` of a partial command line (`cursor` may be argc for a new empty
+ * word), sorted, in the same buffer layout as cargparse_emit_argv. A word starting with '-' gets the
+ * matching "--long" names ("-" also gets the "-s" names), other words get nothing since values are left to
+ * the shell's file completion. */
+cargparse_err_e
+cargparse_complete(const cargparse_t *const self, const int argc, char **argv, const int cursor,
+                   cargparse_argv_buf_t *out);
+
+/* Follows leading command tokens as cargparse_parse_command does; a word in command position gets the
+ * matching subcommand names */
+cargparse_err_e
+cargparse_complete_command(cargparse_command_t *const root, const int argc, char **argv, const int cursor,
+                           cargparse_argv_buf_t *out);
+
+/* Answers `program __complete CWORD WORD...` by printing the candidates one per line and returns true.
+ * Returns false for any other command line, so it can run first thing in main. A program without
+ * subcommands passes a command node holding just its parser. */
+bool
+cargparse_handle_completion(cargparse_command_t *const root, const int argc, char **argv);
+
+/* Writes a bash, zsh or fish script that registers completion for `program` through
+ * cargparse_handle_completion, with the same size contract as cargparse_render_help */
+cargparse_err_e
+cargparse_completion_script(const cargparse_shell_e shell, const char *program, char *buf,
+                            const size_t buf_size, size_t *script_size);
+
 cargparse_err_e
 cargparse_get_bool_long(const cargparse_t *const self, const char *long_name, bool *valuebool);
 
@@ -148,12 +646,34 @@ cargparse_err_e
 cargparse_get_positional(const cargparse_t *const self, const char *long_name, const char **valuestr,
                          const char *default_value, const unsigned idx);
 
+cargparse_err_e
+cargparse_get_map_long(const cargparse_t *const self, const char *long_name, cargparse_map_t *map);
+
+cargparse_err_e
+cargparse_get_map_short(const cargparse_t *const self, const char short_name, cargparse_map_t *map);
+
+cargparse_err_e
+cargparse_map_find(const cargparse_map_t *const map, const char *key, cargparse_slice_t *value);
+
 bool
 cargparse_has_option_long(const cargparse_t *const self, const char *long_name);
 
 bool
 cargparse_has_option_short(const cargparse_t *const self, const char short_name);
 
+/* Index of the named option in `options`, or -1. Hashed once cargparse_prepare has built the index. */
+int
+cargparse_find_option_long(const cargparse_t *const self, const char *long_name);
+
+int
+cargparse_find_option_short(const cargparse_t *const self, const char short_name);
+
+cargparse_err_e
+cargparse_get_source_long(const cargparse_t *const self, const char *long_name, cargparse_source_e *source);
+
+cargparse_err_e
+cargparse_get_source_short(const cargparse_t *const self, const char short_name, cargparse_source_e *source);
+
 cargparse_err_e
 cargparse_get_arg_count_long(const cargparse_t *const self, const char *long_name, unsigned *count);
 
@@ -0,0 +1,349 @@
+#ifndef CARGPARSE_HPP
+#define CARGPARSE_HPP
+
+/* Header-only C++17 front end. Options are declared in a constexpr spec that is validated while compiling
+ * (duplicate names and invalid nargs fail the build) and that carries the name index in the exact layout
+ * cargparse_prepare would build, so parsing starts without setup and getters return views over argv.
+ *
+ *   constexpr auto tool_spec = cargparse::make_spec(
+ *       cargparse::int_option('l', "level", "compaction level", CARGPARSE_FLAG_REQUIRED),
+ *       cargparse::positional("file", "input file"));
+ *   cargparse::parser tool(tool_spec);
+ *   tool.parse(argc, argv);
+ *   std::optional<long> level = tool.get<long>("level"); */
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "cargparse.h"
+
+namespace cargparse {
+
+struct option {
+    cargparse_option_type_e type;
+    char short_name;
+    const char *long_name;
+    const char *help;
+    int flags;
+    int nargs;
+};
+
+constexpr option
+bool_option(char short_name, const char *long_name, const char *help, int flags = CARGPARSE_FLAG_NONE) {
+    return {CARGPARSE_OPTION_TYPE_BOOL, short_name, long_name, help, flags, 1};
+}
+
+constexpr option
+int_option(char short_name, const char *long_name, const char *help, int flags = CARGPARSE_FLAG_NONE,
+           int nargs = 1) {
+    return {CARGPARSE_OPTION_TYPE_INT, short_name, long_name, help, flags, nargs};
+}
+
+constexpr option
+float_option(char short_name, const char *long_name, const char *help, int flags = CARGPARSE_FLAG_NONE,
+             int nargs = 1) {
+    return {CARGPARSE_OPTION_TYPE_FLOAT, short_name, long_name, help, flags, nargs};
+}
+
+constexpr option
+str_option(char short_name, const char *long_name, const char *help, int flags = CARGPARSE_FLAG_NONE,
+           int nargs = 1) {
+    return {CARGPARSE_OPTION_TYPE_STR, short_name, long_name, help, flags, nargs};
+}
+
+constexpr option
+map_option(char short_name, const char *long_name, const char *help, int flags = CARGPARSE_FLAG_NONE) {
+    return {CARGPARSE_OPTION_TYPE_MAP, short_name, long_name, help, flags, 1};
+}
+
+constexpr option
+positional(const char *long_name, const char *help, int flags = CARGPARSE_FLAG_NONE, int nargs = 1) {
+    return {CARGPARSE_OPTION_TYPE_POS, CARGPARSE_NO_SHORT, long_name, help, flags, nargs};
+}
+
+/* Values of an option, pointing into argv */
+struct arg_span {
+    char *const *data;
+    std::size_t size;
+
+    constexpr std::string_view
+    operator[](std::size_t i) const {
+        return data[i];
+    }
+};
+
+namespace detail {
+
+/* Same as _cargparse_hash in cargparse.c */
+constexpr unsigned
+hash(std::string_view str) {
+    unsigned h = 2166136261U;
+    for (char c : str) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619U;
+    }
+    return h;
+}
+
+constexpr bool
+valid_nargs(const option &opt) {
+    if (opt.type == CARGPARSE_OPTION_TYPE_BOOL || opt.type == CARGPARSE_OPTION_TYPE_MAP) {
+        return opt.nargs == 1;
+    }
+    return opt.nargs >= 1 || opt.nargs == CARGPARSE_NARGS_ONE_OR_MORE ||
+           opt.nargs == CARGPARSE_NARGS_ZERO_OR_MORE;
+}
+
+constexpr void
+validate(const option *options, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        const option &opt = options[i];
+        if (opt.short_name == CARGPARSE_NO_SHORT && opt.long_name == CARGPARSE_NO_LONG) {
+            throw std::logic_error("cargparse: option without a name");
+        }
+        if (opt.type == CARGPARSE_OPTION_TYPE_POS && opt.short_name != CARGPARSE_NO_SHORT) {
+            throw std::logic_error("cargparse: positional with a short name");
+        }
+        if (opt.short_name == '-' || opt.short_name == '\0') {
+            throw std::logic_error("cargparse: invalid short name");
+        }
+        if (!valid_nargs(opt)) {
+            throw std::logic_error("cargparse: invalid nargs");
+        }
+        for (std::size_t j = 0; j < i; j++) {
+            if (opt.short_name != CARGPARSE_NO_SHORT && opt.short_name == options[j].short_name) {
+                throw std::logic_error("cargparse: duplicate short name");
+            }
+            if (opt.long_name != CARGPARSE_NO_LONG && options[j].long_name != CARGPARSE_NO_LONG &&
+                std::string_view(opt.long_name) == options[j].long_name) {
+                throw std::logic_error("cargparse: duplicate long name");
+            }
+        }
+    }
+}
+
+}  // namespace detail
+
+template <std::size_t N>
+struct spec {
+    std::array<cargparse_option_t, N> options;
+    std::array<unsigned, CARGPARSE_INDEX_SIZE(N)> index;
+    std::array<cargparse_option_hot_t, N> hot;
+    const char *usages = nullptr;
+    const char *description = nullptr;
+    const char *epilog = nullptr;
+
+    constexpr spec
+    with_help(const char *usages_, const char *description_, const char *epilog_) const {
+        spec copy = *this;
+        copy.usages = usages_;
+        copy.description = description_;
+        copy.epilog = epilog_;
+        return copy;
+    }
+
+    /* Option index by long name, fails the build when used in a constant expression with an unknown name */
+    constexpr std::size_t
+    find(std::string_view long_name) const {
+        constexpr std::size_t n_slots = CARGPARSE_INDEX_SIZE(N) - CARGPARSE_INDEX_SHORT_SLOTS;
+        std::size_t slot = detail::hash(long_name) % n_slots;
+        while (index[CARGPARSE_INDEX_SHORT_SLOTS + slot] != 0) {
+            const std::size_t i = index[CARGPARSE_INDEX_SHORT_SLOTS + slot] - 1;
+            if (long_name == options[i].long_name) return i;
+            slot = (slot + 1) % n_slots;
+        }
+        throw std::out_of_range("cargparse: unknown option");
+    }
+};
+
+namespace detail {
+
+/* Mirrors cargparse_prepare so the C engine sees a ready index */
+template <std::size_t N>
+constexpr std::array<unsigned, CARGPARSE_INDEX_SIZE(N)>
+build_index(const option *options) {
+    constexpr std::size_t n_slots = CARGPARSE_INDEX_SIZE(N) - CARGPARSE_INDEX_SHORT_SLOTS;
+    std::array<unsigned, CARGPARSE_INDEX_SIZE(N)> words{};
+    for (std::size_t i = 0; i < N; i++) {
+        const option &opt = options[i];
+        if (opt.short_name > 0 && static_cast<unsigned char>(opt.short_name) < CARGPARSE_INDEX_SHORT_SLOTS &&
+            words[static_cast<std::size_t>(opt.short_name)] == 0) {
+            words[static_cast<std::size_t>(opt.short_name)] = static_cast<unsigned>(i + 1);
+        }
+        if (opt.long_name == CARGPARSE_NO_LONG) continue;
+
+        unsigned *long_words = words.data() + CARGPARSE_INDEX_SHORT_SLOTS;
+        std::size_t slot = hash(opt.long_name) % n_slots;
+        while (long_words[slot] != 0 &&
+               std::string_view(options[long_words[slot] - 1].long_name) != opt.long_name) {
+            slot = (slot + 1) % n_slots;
+        }
+        if (long_words[slot] == 0) long_words[slot] = static_cast<unsigned>(i + 1);
+    }
+    return words;
+}
+
+template <std::size_t N>
+constexpr std::array<cargparse_option_hot_t, N>
+build_hot(const option *options) {
+    std::array<cargparse_option_hot_t, N> hot{};
+    for (std::size_t i = 0; i < N; i++) {
+        const std::size_t len = options[i].long_name ? std::string_view(options[i].long_name).size() : 0;
+        hot[i].hash = options[i].long_name ? hash(options[i].long_name) : 0;
+        hot[i].nargs = options[i].nargs;
+        hot[i].flags = static_cast<unsigned short>(options[i].flags);
+        hot[i].type = static_cast<unsigned char>(options[i].type);
+        hot[i].name_len = static_cast<unsigned char>(len < 255 ? len : 255);
+    }
+    return hot;
+}
+
+template <std::size_t N, std::size_t... I>
+constexpr std::array<cargparse_option_t, N>
+to_c_options(const option *options, std::index_sequence<I...>) {
+    return {{cargparse_option_t{options[I].type, options[I].short_name, options[I].long_name, options[I].help,
+                                options[I].flags, options[I].nargs}...}};
+}
+
+}  // namespace detail
+
+template <typename... Options>
+constexpr spec<sizeof...(Options)>
+make_spec(const Options &...opts) {
+    constexpr std::size_t N = sizeof...(Options);
+    static_assert(N > 0, "cargparse: a spec needs at least one option");
+    const option options[N] = {opts...};
+
+    detail::validate(options, N);
+    return {detail::to_c_options<N>(options, std::make_index_sequence<N>{}), detail::build_index<N>(options),
+            detail::build_hot<N>(options)};
+}
+
+/* Result state for one parse over a constexpr spec; the spec must outlive the parser */
+template <std::size_t N>
+class parser {
+  public:
+    explicit parser(const spec<N> &spec_)
+        : res_{},
+          /* the index is never written once built, cargparse_prepare returns early */
+          self_{spec_.usages,
+                spec_.description,
+                spec_.epilog,
+                spec_.options.data(),
+                res_.data(),
+                static_cast<int>(N),
+                {const_cast<unsigned *>(spec_.index.data()), static_cast<unsigned>(spec_.index.size()), true,
+                 const_cast<cargparse_option_hot_t *>(spec_.hot.data())},
+                nullptr,
+                nullptr,
+                0,
+                nullptr,
+                nullptr,
+                nullptr} {
+    }
+
+    parser(const parser &) = delete;
+    parser &operator=(const parser &) = delete;
+
+    cargparse_err_e
+    parse(int argc, char **argv) {
+        return cargparse_parse(&self_, argc, argv);
+    }
+
+    const cargparse_t *
+    c_parser() const {
+        return &self_;
+    }
+
+    cargparse_t *
+    c_parser() {
+        return &self_;
+    }
+
+    bool
+    is_got(std::size_t opt_idx) const {
+        return opt_idx < N && res_[opt_idx].is_got;
+    }
+
+    /* T is bool, long, double, std::string_view or arg_span; nullopt when the option is unknown, not got, of
+     * another type or not convertible */
+    template <typename T>
+    std::optional<T>
+    get(std::size_t opt_idx, unsigned idx = 0) const {
+        if (opt_idx >= N) return std::nullopt;
+        return value_at<T>(self_.options[opt_idx], res_[opt_idx], idx);
+    }
+
+    template <typename T>
+    std::optional<T>
+    get(const char *long_name, unsigned idx = 0) const {
+        return get<T>(index_of(long_name), idx);
+    }
+
+  private:
+    std::size_t
+    index_of(std::string_view long_name) const {
+        constexpr std::size_t n_slots = CARGPARSE_INDEX_SIZE(N) - CARGPARSE_INDEX_SHORT_SLOTS;
+        const unsigned *words = self_.index.words + CARGPARSE_INDEX_SHORT_SLOTS;
+        std::size_t slot = detail::hash(long_name) % n_slots;
+
+        while (words[slot] != 0) {
+            if (long_name == self_.options[words[slot] - 1].long_name) return words[slot] - 1;
+            slot = (slot + 1) % n_slots;
+        }
+        return N;
+    }
+
+    template <typename T>
+    std::optional<T>
+    value_at(const cargparse_option_t &opt, const cargparse_parse_res_t &res, unsigned idx) const {
+        [[maybe_unused]] cargparse_err_e ret;
+
+        if constexpr (std::is_same_v<T, bool>) {
+            bool value = false;
+            ret = opt.long_name ? cargparse_get_bool_long(&self_, opt.long_name, &value)
+                                : cargparse_get_bool_short(&self_, opt.short_name, &value);
+            if (ret != CARGPARSE_OK && ret != CARGPARSE_DEFAULT_VALUE) return std::nullopt;
+            return value;
+        } else if constexpr (std::is_same_v<T, long>) {
+            long value = 0;
+            ret = opt.long_name ? cargparse_get_int_long(&self_, opt.long_name, &value, 0, idx)
+                                : cargparse_get_int_short(&self_, opt.short_name, &value, 0, idx);
+            if (ret != CARGPARSE_OK) return std::nullopt;
+            return value;
+        } else if constexpr (std::is_same_v<T, double>) {
+            double value = 0.0;
+            ret = opt.long_name ? cargparse_get_float_long(&self_, opt.long_name, &value, 0.0, idx)
+                                : cargparse_get_float_short(&self_, opt.short_name, &value, 0.0, idx);
+            if (ret != CARGPARSE_OK) return std::nullopt;
+            return value;
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+            const std::optional<arg_span> values = value_at<arg_span>(opt, res, 0);
+            if (!values || idx >= values->size) return std::nullopt;
+            return (*values)[idx];
+        } else {
+            static_assert(std::is_same_v<T, arg_span>, "cargparse: unsupported value type");
+            (void)idx;
+            if (!res.is_got || opt.type == CARGPARSE_OPTION_TYPE_BOOL ||
+                opt.type == CARGPARSE_OPTION_TYPE_MAP) {
+                return std::nullopt;
+            }
+            return arg_span{res.valuestr, static_cast<std::size_t>(res.nargs)};
+        }
+    }
+
+    std::array<cargparse_parse_res_t, N> res_;
+    cargparse_t self_;
+};
+
+template <std::size_t N>
+parser(const spec<N> &) -> parser<N>;
+
+}  // namespace cargparse
+
+#endif /* CARGPARSE_HPP */
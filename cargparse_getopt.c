@@ -0,0 +1,322 @@
+#define _DEFAULT_SOURCE
+
+#include "cargparse_getopt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* has_arg is kept in the compiled options: BOOL takes none, STR with one argument requires it and STR with
+ * zero or more takes an optional one */
+static cargparse_err_e
+_cargparse_getopt_add(cargparse_getopt_spec_t *const self, const char short_name, const char *long_name,
+                      const int has_arg, const int longindex) {
+    cargparse_err_e ret;
+    const cargparse_option_t opt = {
+        has_arg == no_argument ? CARGPARSE_OPTION_TYPE_BOOL : CARGPARSE_OPTION_TYPE_STR,
+        short_name,
+        long_name,
+        NULL,
+        CARGPARSE_FLAG_NONE,
+        has_arg == optional_argument ? CARGPARSE_NARGS_ZERO_OR_MORE : 1,
+    };
+
+    ret = cargparse_builder_add(&self->builder, &opt);
+    /* getopt_long takes the first of repeated names */
+    if (ret == CARGPARSE_ERR_INVALID_OPTION) return CARGPARSE_OK;
+    if (ret != CARGPARSE_OK) return ret;
+    self->longindexes[self->builder.n_options - 1] = longindex;
+    return CARGPARSE_OK;
+}
+
+static int
+_cargparse_getopt_has_arg(const cargparse_option_t *const opt) {
+    if (opt->type == CARGPARSE_OPTION_TYPE_BOOL) return no_argument;
+    return opt->nargs == CARGPARSE_NARGS_ZERO_OR_MORE ? optional_argument : required_argument;
+}
+
+cargparse_err_e
+cargparse_getopt_compile(cargparse_getopt_spec_t *const self, const char *optstring,
+                         const struct option *longopts) {
+    int i, has_arg;
+    size_t n_short;
+    const char *c;
+    cargparse_err_e ret;
+
+    if (!self) return CARGPARSE_ERR_NULL_PARSER;
+    if (!optstring) return CARGPARSE_ERR_NULL_ARGUMENT;
+
+    memset(self, 0, sizeof(*self));
+    cargparse_builder_init(&self->builder, NULL, NULL, NULL);
+    self->longopts = longopts;
+    for (i = 0; longopts && longopts[i].name; i++) {
+    }
+    self->n_longopts = i;
+
+    self->ordering = getenv("POSIXLY_CORRECT") ? CARGPARSE_GETOPT_REQUIRE_ORDER : CARGPARSE_GETOPT_PERMUTE;
+    if (*optstring == '-') {
+        self->ordering = CARGPARSE_GETOPT_RETURN_IN_ORDER;
+        optstring++;
+    } else if (*optstring == '+') {
+        self->ordering = CARGPARSE_GETOPT_REQUIRE_ORDER;
+        optstring++;
+    }
+    if (*optstring == ':') {
+        self->is_silent = true;
+        optstring++;
+    }
+
+    n_short = strlen(optstring);
+    if (!(self->longindexes = malloc(sizeof(int) * ((size_t)self->n_longopts + n_short + 1)))) {
+        return CARGPARSE_ERR_NO_MEMORY;
+    }
+    for (i = 0; i < self->n_longopts; i++) {
+        ret = _cargparse_getopt_add(self, CARGPARSE_NO_SHORT, longopts[i].name, longopts[i].has_arg, i);
+        if (ret != CARGPARSE_OK) {
+            cargparse_getopt_destroy(self);
+            return ret;
+        }
+    }
+    for (c = optstring; *c != '\0'; c++) {
+        if (*c == ':' || *c == ';') continue;
+        has_arg = c[1] != ':' ? no_argument : c[2] != ':' ? required_argument : optional_argument;
+        if ((ret = _cargparse_getopt_add(self, *c, CARGPARSE_NO_LONG, has_arg, -1)) != CARGPARSE_OK) {
+            cargparse_getopt_destroy(self);
+            return ret;
+        }
+    }
+
+    if ((ret = cargparse_builder_freeze(&self->builder, &self->parser)) != CARGPARSE_OK) {
+        cargparse_getopt_destroy(self);
+        return ret;
+    }
+    return CARGPARSE_OK;
+}
+
+void
+cargparse_getopt_destroy(cargparse_getopt_spec_t *const self) {
+    if (!self) return;
+    cargparse_builder_destroy(&self->builder);
+    free(self->longindexes);
+    memset(self, 0, sizeof(*self));
+}
+
+void
+cargparse_getopt_state_init(cargparse_getopt_state_t *const state) {
+    const cargparse_getopt_state_t init = CARGPARSE_GETOPT_STATE_INIT;
+
+    if (state) memcpy(state, &init, sizeof(init));
+}
+
+static void
+_cargparse_getopt_reverse(char **argv, int from, int to) {
+    char *tmp;
+
+    for (to--; from < to; from++, to--) {
+        tmp = argv[from];
+        argv[from] = argv[to];
+        argv[to] = tmp;
+    }
+}
+
+/* Moves the options in [last_nonopt, optind) before the skipped non-options in [first_nonopt,
+ * last_nonopt), as getopt_long permutes argv */
+static void
+_cargparse_getopt_exchange(cargparse_getopt_state_t *const state, char **argv) {
+    _cargparse_getopt_reverse(argv, state->first_nonopt, state->last_nonopt);
+    _cargparse_getopt_reverse(argv, state->last_nonopt, state->optind);
+    _cargparse_getopt_reverse(argv, state->first_nonopt, state->optind);
+    state->first_nonopt += state->optind - state->last_nonopt;
+    state->last_nonopt = state->optind;
+}
+
+static bool
+_cargparse_getopt_is_nonopt(const char *arg) {
+    return arg[0] != '-' || arg[1] == '\0';
+}
+
+static bool
+_cargparse_getopt_prints(const cargparse_getopt_spec_t *const self, const cargparse_getopt_state_t *state) {
+    return state->opterr && !self->is_silent;
+}
+
+/* Unique abbreviation of a long name, or several that all mean the same, like getopt_long */
+static int
+_cargparse_getopt_abbrev(const cargparse_getopt_spec_t *const self, const char *name, const size_t len,
+                         bool *is_ambiguous) {
+    int i, found = -1;
+    const struct option *opt, *first;
+
+    *is_ambiguous = false;
+    for (i = 0; i < self->n_longopts; i++) {
+        opt = &self->longopts[i];
+        if (strncmp(opt->name, name, len) != 0) continue;
+        if (found == -1) {
+            found = i;
+            continue;
+        }
+        first = &self->longopts[found];
+        if (opt->has_arg != first->has_arg || opt->flag != first->flag || opt->val != first->val) {
+            *is_ambiguous = true;
+        }
+    }
+    return found;
+}
+
+static int
+_cargparse_getopt_long_option(const cargparse_getopt_spec_t *const self, cargparse_getopt_state_t *state,
+                              const int argc, char *const argv[], int *longindex) {
+    int opt_idx, idx = -1;
+    bool is_ambiguous = false;
+    char name[256], *name_end, *arg = state->next_char;
+    size_t len;
+    const struct option *opt;
+
+    name_end = strchr(arg, '=');
+    len = name_end ? (size_t)(name_end - arg) : strlen(arg);
+    state->next_char = NULL;
+    state->optind++;
+
+    if (len < sizeof(name)) {
+        memcpy(name, arg, len);
+        name[len] = '\0';
+        opt_idx = cargparse_find_option_long(&self->parser, name);
+        if (opt_idx != -1) idx = self->longindexes[opt_idx];
+    }
+    if (idx == -1) idx = _cargparse_getopt_abbrev(self, arg, len, &is_ambiguous);
+    if (idx == -1 || is_ambiguous) {
+        if (_cargparse_getopt_prints(self, state)) {
+            fprintf(stderr, "%s: %s '--%.*s'%s\n", argv[0], is_ambiguous ? "option" : "unrecognized option",
+                    (int)len, arg, is_ambiguous ? " is ambiguous" : "");
+        }
+        state->optopt = 0;
+        return '?';
+    }
+
+    opt = &self->longopts[idx];
+    if (name_end) {
+        if (opt->has_arg == no_argument) {
+            if (_cargparse_getopt_prints(self, state)) {
+                fprintf(stderr, "%s: option '--%s' doesn't allow an argument\n", argv[0], opt->name);
+            }
+            state->optopt = opt->val;
+            return '?';
+        }
+        state->optarg = name_end + 1;
+    } else if (opt->has_arg == required_argument) {
+        if (state->optind >= argc) {
+            if (_cargparse_getopt_prints(self, state)) {
+                fprintf(stderr, "%s: option '--%s' requires an argument\n", argv[0], opt->name);
+            }
+            state->optopt = opt->val;
+            return self->is_silent ? ':' : '?';
+        }
+        state->optarg = argv[state->optind++];
+    }
+
+    if (longindex) *longindex = idx;
+    if (opt->flag) {
+        *opt->flag = opt->val;
+        return 0;
+    }
+    return opt->val;
+}
+
+static int
+_cargparse_getopt_short_option(const cargparse_getopt_spec_t *const self, cargparse_getopt_state_t *state,
+                               const int argc, char *const argv[]) {
+    int opt_idx, has_arg;
+    char c = *state->next_char++;
+
+    if (*state->next_char == '\0') state->optind++;
+
+    opt_idx = cargparse_find_option_short(&self->parser, c);
+    if (opt_idx == -1) {
+        if (_cargparse_getopt_prints(self, state)) {
+            fprintf(stderr, "%s: invalid option -- '%c'\n", argv[0], c);
+        }
+        state->optopt = (unsigned char)c;
+        return '?';
+    }
+
+    has_arg = _cargparse_getopt_has_arg(&self->parser.options[opt_idx]);
+    if (has_arg == no_argument) return (unsigned char)c;
+
+    if (*state->next_char != '\0') {
+        state->optarg = state->next_char;
+        state->optind++;
+    } else if (has_arg == required_argument) {
+        if (state->optind >= argc) {
+            if (_cargparse_getopt_prints(self, state)) {
+                fprintf(stderr, "%s: option requires an argument -- '%c'\n", argv[0], c);
+            }
+            state->next_char = NULL;
+            state->optopt = (unsigned char)c;
+            return self->is_silent ? ':' : '?';
+        }
+        state->optarg = argv[state->optind++];
+    }
+    state->next_char = NULL;
+    return (unsigned char)c;
+}
+
+int
+cargparse_getopt_long(const cargparse_getopt_spec_t *const self, cargparse_getopt_state_t *const state,
+                      const int argc, char *const argv[], int *longindex) {
+    /* argv is permuted in place, as glibc does in spite of the const */
+    char **args = (char **)argv;
+
+    if (!self || !state || !argv) return -1;
+    state->optarg = NULL;
+    if (state->optind < 1) {
+        /* a restart keeps opterr and optopt, as in glibc */
+        state->optind = 1;
+        state->first_nonopt = 1;
+        state->last_nonopt = 1;
+        state->next_char = NULL;
+    }
+
+    if (!state->next_char || *state->next_char == '\0') {
+        if (state->last_nonopt > state->optind) state->last_nonopt = state->optind;
+        if (state->first_nonopt > state->optind) state->first_nonopt = state->optind;
+
+        if (self->ordering == CARGPARSE_GETOPT_PERMUTE) {
+            if (state->first_nonopt != state->last_nonopt && state->last_nonopt != state->optind) {
+                _cargparse_getopt_exchange(state, args);
+            } else if (state->last_nonopt != state->optind) {
+                state->first_nonopt = state->optind;
+            }
+            while (state->optind < argc && _cargparse_getopt_is_nonopt(argv[state->optind])) state->optind++;
+            state->last_nonopt = state->optind;
+        }
+
+        if (state->optind < argc && strcmp(argv[state->optind], "--") == 0) {
+            state->optind++;
+            if (state->first_nonopt != state->last_nonopt && state->last_nonopt != state->optind) {
+                _cargparse_getopt_exchange(state, args);
+            } else if (state->first_nonopt == state->last_nonopt) {
+                state->first_nonopt = state->optind;
+            }
+            state->last_nonopt = argc;
+            state->optind = argc;
+        }
+
+        if (state->optind >= argc) {
+            /* point at the non-options moved to the end */
+            if (state->first_nonopt != state->last_nonopt) state->optind = state->first_nonopt;
+            return -1;
+        }
+        if (_cargparse_getopt_is_nonopt(argv[state->optind])) {
+            if (self->ordering == CARGPARSE_GETOPT_REQUIRE_ORDER) return -1;
+            state->optarg = argv[state->optind++];
+            return 1;
+        }
+
+        if (argv[state->optind][1] == '-' && self->n_longopts > 0) {
+            state->next_char = argv[state->optind] + 2;
+            return _cargparse_getopt_long_option(self, state, argc, argv, longindex);
+        }
+        state->next_char = argv[state->optind] + 1;
+    }
+    return _cargparse_getopt_short_option(self, state, argc, argv);
+}
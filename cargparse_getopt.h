@@ -0,0 +1,68 @@
+#ifndef CARGPARSE_GETOPT_H
+#define CARGPARSE_GETOPT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <getopt.h>
+
+#include "cargparse.h"
+
+typedef enum {
+    CARGPARSE_GETOPT_PERMUTE = 0,    /* options anywhere, non-options are moved to the end */
+    CARGPARSE_GETOPT_REQUIRE_ORDER,  /* stop at the first non-option: '+' or POSIXLY_CORRECT */
+    CARGPARSE_GETOPT_RETURN_IN_ORDER /* non-options are returned as option 1: '-' */
+} cargparse_getopt_ordering_e;
+
+/* An optstring and `struct option` array compiled once into a frozen cargparse spec, so names are found
+ * through the hash index instead of getopt_long's scan of every long option. Read-only after
+ * cargparse_getopt_compile and shared by any number of cargparse_getopt_state_t. */
+typedef struct {
+    cargparse_builder_t builder;
+    cargparse_t parser;
+    const struct option *longopts;
+    int n_longopts;
+    int *longindexes; /* into `longopts` for every option of `parser`, -1 for short ones */
+    cargparse_getopt_ordering_e ordering;
+    bool is_silent; /* optstring starts with ':', missing arguments return ':' and nothing is printed */
+} cargparse_getopt_spec_t;
+
+/* What getopt_long keeps in globals, one per argv walk. `optind`, `optarg`, `optopt` and `opterr` mean
+ * what the globals of the same name do. */
+typedef struct {
+    int optind;
+    char *optarg;
+    int optopt;
+    int opterr;
+    char *next_char; /* rest of a short option cluster */
+    int first_nonopt;
+    int last_nonopt;
+} cargparse_getopt_state_t;
+
+#define CARGPARSE_GETOPT_STATE_INIT {1, NULL, '?', 1, NULL, 1, 1}
+
+/* `longopts` ends with a zeroed entry as for getopt_long and must outlive the spec. Repeated names keep
+ * their first definition. "W;" is not supported. */
+cargparse_err_e
+cargparse_getopt_compile(cargparse_getopt_spec_t *const self, const char *optstring,
+                         const struct option *longopts);
+
+void
+cargparse_getopt_destroy(cargparse_getopt_spec_t *const self);
+
+void
+cargparse_getopt_state_init(cargparse_getopt_state_t *const state);
+
+/* getopt_long with its globals in `state`: same return values, messages, argv permutation and unique
+ * abbreviations of long names. Walks from `state->optind`, so a fresh state or `optind` set to 0 restarts
+ * the walk; the latter keeps `opterr`. */
+int
+cargparse_getopt_long(const cargparse_getopt_spec_t *const self, cargparse_getopt_state_t *const state,
+                      const int argc, char *const argv[], int *longindex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CARGPARSE_GETOPT_H */
@@ -0,0 +1,12 @@
+# parser for test_generated_parser, compiled by cargparse_gen
+name        gen_tool
+usages      "gen_tool [OPTION]... FILE [REST]...\ngen_tool --help"
+description "Generated parser example."
+epilog      "Epilog example."
+
+option int   l level   1 required "compaction level"
+option bool  v verbose -  none     "verbose output"
+option str   - name    -  env      "name of \"something\""
+option float r ratio   2  none     "ratios"
+option pos   - file    -  required "input file"
+option pos   - rest    +  none     "other files"
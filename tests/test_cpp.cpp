@@ -0,0 +1,104 @@
+#include <cstring>
+#include <string_view>
+
+#include "../cargparse.hpp"
+
+extern "C" {
+#include "test_core.h"
+}
+
+/* clang-format off */
+constexpr auto tool_spec = cargparse::make_spec(
+    cargparse::int_option('l', "level", "compaction level", CARGPARSE_FLAG_REQUIRED),
+    cargparse::bool_option('v', "verbose", "verbose output"),
+    cargparse::str_option(CARGPARSE_NO_SHORT, "name", "name of something"),
+    cargparse::float_option('r', "ratio", "two ratios", CARGPARSE_FLAG_NONE, 2),
+    cargparse::positional("file", "input file"),
+    cargparse::positional("rest", "other files", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ONE_OR_MORE)
+).with_help("tool [OPTION]... FILE [REST]...", "Tool description.", NULL);
+/* clang-format on */
+
+/* checked names resolve while compiling */
+constexpr std::size_t level_opt = tool_spec.find("level");
+constexpr std::size_t rest_opt = tool_spec.find("rest");
+static_assert(level_opt == 0 && rest_opt == 5, "long names resolve to their option index");
+static_assert(tool_spec.index['l'] == 1 && tool_spec.index['v'] == 2, "short names are in the index");
+
+#if defined(CARGPARSE_EXPECT_FAIL_DUPLICATE)
+constexpr auto bad_spec = cargparse::make_spec(cargparse::bool_option('v', "verbose", "verbose output"),
+                                               cargparse::bool_option('v', "version", "print version"));
+#elif defined(CARGPARSE_EXPECT_FAIL_NARGS)
+constexpr auto bad_spec = cargparse::make_spec(cargparse::int_option('l', "level", "level", 0, 0));
+#elif defined(CARGPARSE_EXPECT_FAIL_UNKNOWN)
+constexpr std::size_t bad_opt = tool_spec.find("levels");
+#endif
+
+/* the constexpr index must be the one the C library would build */
+int
+test_cpp_index_matches_prepare(void) {
+    unsigned words[CARGPARSE_INDEX_SIZE(6)] = {0};
+    cargparse_option_hot_t hot[6] = {};
+    cargparse_parse_res_t res[6] = {};
+    cargparse_t c_parser = {NULL, NULL, NULL, tool_spec.options.data(), res, 6,
+                            {words, CARGPARSE_INDEX_SIZE(6), false, hot}, NULL, NULL, 0,
+                            NULL, NULL, NULL};
+
+    cargparse_prepare(&c_parser);
+    TEST(std::memcmp(words, tool_spec.index.data(), sizeof(words)) == 0);
+    TEST(std::memcmp(hot, tool_spec.hot.data(), sizeof(hot)) == 0);
+    return 0;
+}
+
+int
+test_cpp_typed_get(void) {
+    char *argv[] = {(char *)"tool", (char *)"-l",      (char *)"3",         (char *)"--ratio", (char *)"0.5",
+                    (char *)"1.5",  (char *)"-v",      (char *)"input.txt", (char *)"a",       (char *)"b"};
+    cargparse::parser tool(tool_spec);
+
+    TEST(tool.c_parser()->index.is_built);
+    TEST(tool.parse(sizeof(argv) / sizeof(char *), argv) == CARGPARSE_OK);
+
+    TEST(tool.get<long>(level_opt) == 3L);
+    TEST(tool.get<long>("level") == 3L);
+    TEST(tool.get<bool>("verbose") == true);
+    TEST(tool.get<double>("ratio", 1) == 1.5);
+    TEST(!tool.get<std::string_view>("name"));
+    TEST(tool.get<std::string_view>("file") == std::string_view("input.txt"));
+    TEST(tool.get<std::string_view>("level") == std::string_view("3"));
+
+    /* views point into argv, nothing is copied */
+    const std::optional<cargparse::arg_span> rest = tool.get<cargparse::arg_span>(rest_opt);
+    TEST(rest && rest->size == 2);
+    TEST(rest->data == &argv[8]);
+    TEST((*rest)[1] == "b");
+
+    /* wrong type or unknown name */
+    TEST(!tool.get<cargparse::arg_span>("verbose"));
+    TEST(!tool.get<long>("file"));
+    TEST(!tool.get<long>("levels"));
+    TEST(!tool.get<long>(tool_spec.options.size()));
+    return 0;
+}
+
+int
+test_cpp_parse_error(void) {
+    char *argv[] = {(char *)"tool", (char *)"-v", (char *)"input.txt", (char *)"a"};
+    cargparse::parser tool(tool_spec);
+
+    TEST(tool.parse(sizeof(argv) / sizeof(char *), argv) == CARGPARSE_ERR_NOT_ALL_REQUIRED_OPTIONS);
+    TEST(!tool.is_got(level_opt));
+    return 0;
+}
+
+int
+main(void) {
+    printf("\nRunning C++ tests...\n");
+
+    RUN_TEST(test_cpp_index_matches_prepare);
+    RUN_TEST(test_cpp_typed_get);
+    RUN_TEST(test_cpp_parse_error);
+
+    print_test_summary();
+
+    return failed_tests != 0;
+}
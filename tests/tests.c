@@ -1,8 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../cargparse.h"
+#include "../cargparse_getopt.h"
+#include "gen_args.h"
 #include "test_core.h"
 
 /* clang-format off */
@@ -14,9 +20,9 @@ CARGPARSE_INIT(test_argparse,
     CARGPARSE_OPTION_BOOL(CARGPARSE_NO_SHORT, "bool", "bool for something", CARGPARSE_FLAG_NONE),
     CARGPARSE_OPTION_STRING(CARGPARSE_NO_SHORT, "some-str", "some string", CARGPARSE_FLAG_NONE, 0),
     CARGPARSE_OPTION_FLOAT('f', "float", "some float", CARGPARSE_FLAG_NONE, 0),
-    CARGPARSE_OPTION_POSITIONAL("positional1", "positional argument example", CARGPARSE_FLAG_NONE),
-    CARGPARSE_OPTION_POSITIONAL("positional2", "positional argument example", CARGPARSE_FLAG_NONE),
-    CARGPARSE_OPTION_POSITIONAL("positional3", "positional argument example", CARGPARSE_FLAG_NONE),
+    CARGPARSE_OPTION_POSITIONAL("positional1", "positional argument example", CARGPARSE_FLAG_NONE, 1),
+    CARGPARSE_OPTION_POSITIONAL("positional2", "positional argument example", CARGPARSE_FLAG_NONE, 1),
+    CARGPARSE_OPTION_POSITIONAL("positional3", "positional argument example", CARGPARSE_FLAG_NONE, 1),
 );
 /* clang-format on */
 
@@ -43,7 +49,14 @@ test_argparse_init_test(void) {
                                                  "Epilog example.",
                                                  hand_init_opts,
                                                  hand_init_parse_res,
-                                                 7};
+                                                 7,
+                                                 {NULL, 0, false, NULL},
+                                                 NULL,
+                                                 NULL,
+                                                 0,
+                                                 NULL,
+                                                 NULL,
+                                                 NULL};
 
     /* compare macro init and hand init */
     TEST_EQ_STR(test_argparse.usages, hand_init_test_argparse.usages);
@@ -96,7 +109,7 @@ option_init_test(void) {
     TEST(cmp_options(&o4m, &o4h));
 
     const cargparse_option_t o5m =
-        CARGPARSE_OPTION_POSITIONAL("positional", "some positional", CARGPARSE_FLAG_NONE);
+        CARGPARSE_OPTION_POSITIONAL("positional", "some positional", CARGPARSE_FLAG_NONE, 1);
     const cargparse_option_t o5h = {CARGPARSE_OPTION_TYPE_POS, CARGPARSE_NO_SHORT,  "positional",
                                     "some positional",         CARGPARSE_FLAG_NONE, 1};
     TEST(cmp_options(&o5m, &o5h));
@@ -112,8 +125,10 @@ test_argparse_all_opts(void) {
     cargparse_parse(&test_argparse, sizeof(argv) / sizeof(char *), argv);
 
     const cargparse_parse_res_t parse_res[] = {
-        {true, &argv[2], 1}, {true, NULL, 0},      {true, &argv[5], 1},  {true, &argv[7], 1},
-        {true, &argv[9], 1}, {true, &argv[10], 1}, {true, &argv[11], 1},
+        {true, &argv[2], 1, NULL, CARGPARSE_SOURCE_NONE}, {true, NULL, 0, NULL, CARGPARSE_SOURCE_NONE},
+        {true, &argv[5], 1, NULL, CARGPARSE_SOURCE_NONE}, {true, &argv[7], 1, NULL, CARGPARSE_SOURCE_NONE},
+        {true, &argv[9], 1, NULL, CARGPARSE_SOURCE_NONE}, {true, &argv[10], 1, NULL, CARGPARSE_SOURCE_NONE},
+        {true, &argv[11], 1, NULL, CARGPARSE_SOURCE_NONE},
     };
     for (i = 0; i < test_argparse.n_options; i++) {
         TEST(cmp_parse_res(&test_argparse.parse_res[i], &parse_res[i]));
@@ -182,8 +197,10 @@ int
 test_argparse_positional(void) {
     char *argv1[] = {"program", "pos1"};
     const cargparse_parse_res_t parse_res1[] = {
-        {false, NULL, 0},     {false, NULL, 0}, {false, NULL, 0}, {false, NULL, 0},
-        {true, &argv1[1], 1}, {false, NULL, 0}, {false, NULL, 0},
+        {false, NULL, 0, NULL, CARGPARSE_SOURCE_NONE}, {false, NULL, 0, NULL, CARGPARSE_SOURCE_NONE},
+        {false, NULL, 0, NULL, CARGPARSE_SOURCE_NONE}, {false, NULL, 0, NULL, CARGPARSE_SOURCE_NONE},
+        {true, &argv1[1], 1, NULL, CARGPARSE_SOURCE_NONE}, {false, NULL, 0, NULL, CARGPARSE_SOURCE_NONE},
+        {false, NULL, 0, NULL, CARGPARSE_SOURCE_NONE},
     };
     /*
     const cargparse_parse_res_t parse_res2[] = {
@@ -238,8 +255,10 @@ test_argparse_getters(void) {
     cargparse_parse(&test_argparse, sizeof(argv) / sizeof(char *), argv);
 
     const cargparse_parse_res_t parse_res[] = {
-        {true, &argv[2], 1}, {true, NULL, 1},      {true, &argv[5], 1},  {true, &argv[7], 1},
-        {true, &argv[9], 1}, {true, &argv[10], 1}, {true, &argv[11], 1},
+        {true, &argv[2], 1, NULL, CARGPARSE_SOURCE_NONE}, {true, NULL, 1, NULL, CARGPARSE_SOURCE_NONE},
+        {true, &argv[5], 1, NULL, CARGPARSE_SOURCE_NONE}, {true, &argv[7], 1, NULL, CARGPARSE_SOURCE_NONE},
+        {true, &argv[9], 1, NULL, CARGPARSE_SOURCE_NONE}, {true, &argv[10], 1, NULL, CARGPARSE_SOURCE_NONE},
+        {true, &argv[11], 1, NULL, CARGPARSE_SOURCE_NONE},
     };
     for (i = 0; i < test_argparse.n_options; i++) {
         TEST(cmp_parse_res(&test_argparse.parse_res[i], &parse_res[i]));
@@ -263,13 +282,16 @@ test_argparse_getters(void) {
     TEST_EQ(cargparse_get_int_long(&test_argparse, "number", &d, 0, 0), (cargparse_err_e)CARGPARSE_OK);
     TEST_EQ(d, (long)10);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional1", &s, NULL), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional1", &s, NULL, 0),
+            (cargparse_err_e)CARGPARSE_OK);
     TEST(strcmp(s, "pos1") == 0);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional2", &s, NULL), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional2", &s, NULL, 0),
+            (cargparse_err_e)CARGPARSE_OK);
     TEST(strcmp(s, "pos2") == 0);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional3", &s, NULL), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional3", &s, NULL, 0),
+            (cargparse_err_e)CARGPARSE_OK);
     TEST(strcmp(s, "pos3") == 0);
 
     CARGPARSE_PARSE_RES_CLEANUP(&test_argparse);
@@ -310,13 +332,13 @@ test_argparse_getters_unknown(void) {
     TEST_EQ(cargparse_get_int_long(&test_argparse, "number-unk", &d, -4321, 0),
             (cargparse_err_e)CARGPARSE_ERR_OPTION_UNKNOWN);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional1-ukn", &s, "pos1_default"),
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional1-ukn", &s, "pos1_default", 0),
             (cargparse_err_e)CARGPARSE_ERR_OPTION_UNKNOWN);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional2-ukn", &s, "pos2_default"),
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional2-ukn", &s, "pos2_default", 0),
             (cargparse_err_e)CARGPARSE_ERR_OPTION_UNKNOWN);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional3-ukn", &s, "pos3_default"),
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional3-ukn", &s, "pos3_default", 0),
             (cargparse_err_e)CARGPARSE_ERR_OPTION_UNKNOWN);
 
     CARGPARSE_PARSE_RES_CLEANUP(&test_argparse);
@@ -362,15 +384,15 @@ test_argparse_getters_defaults(void) {
             (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
     TEST_EQ(d, (long)-4321);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional1", &s, "pos1_default"),
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional1", &s, "pos1_default", 0),
             (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
     TEST(strcmp(s, "pos1_default") == 0);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional2", &s, "pos2_default"),
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional2", &s, "pos2_default", 0),
             (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
     TEST(strcmp(s, "pos2_default") == 0);
 
-    TEST_EQ(cargparse_get_positional(&test_argparse, "positional3", &s, "pos3_default"),
+    TEST_EQ(cargparse_get_positional(&test_argparse, "positional3", &s, "pos3_default", 0),
             (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
     TEST(strcmp(s, "pos3_default") == 0);
 
@@ -384,7 +406,7 @@ test_required_args(void) {
     CARGPARSE_INIT(test_req, NULL, NULL, NULL,
         CARGPARSE_OPTION_INT('n', "number", "number of something", CARGPARSE_FLAG_REQUIRED, 0),
         CARGPARSE_OPTION_INT('d', "d number", "d number of something", CARGPARSE_FLAG_NONE, 0),
-        CARGPARSE_OPTION_POSITIONAL("pos1", "first positional argument", CARGPARSE_FLAG_REQUIRED),
+        CARGPARSE_OPTION_POSITIONAL("pos1", "first positional argument", CARGPARSE_FLAG_REQUIRED, 1),
     );
     /* clang-format on */
 
@@ -399,6 +421,1287 @@ test_required_args(void) {
     return 0;
 }
 
+int
+test_map_option(void) {
+    cargparse_slice_t v;
+    char *argv[] = {"program", "-o", "ro,uid=1000", "--verbose", "--opt", "mode=0755,uid=0", "file"};
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_map, NULL, NULL, NULL,
+        CARGPARSE_OPTION_MAP('o', "opt", "mount-style options", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_POSITIONAL("file", "file", CARGPARSE_FLAG_NONE, 1),
+    );
+    /* clang-format on */
+    CARGPARSE_MAP_INIT(map, 8);
+    CARGPARSE_MAP_INIT_NO_HASH(map_linear, 8);
+    CARGPARSE_MAP_INIT_NO_HASH(map_small, 2);
+
+    TEST_EQ(cargparse_get_map_long(&test_map, "opt", &map), (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
+    TEST_EQ(map.n_pairs, 0u);
+
+    TEST_EQ(cargparse_parse(&test_map, sizeof(argv) / sizeof(char *), argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_get_map_short(&test_map, 'o', &map), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(map.n_pairs, 4u);
+    TEST(map.pairs[0].key.len == 2 && strncmp(map.pairs[0].key.str, "ro", 2) == 0);
+    TEST_EQ(map.pairs[0].value.len, 0u);
+    TEST(map.pairs[3].key.str == argv[5] + 10);
+
+    /* zero-copy: slices point into argv, the latest value of a repeated key wins */
+    TEST_EQ(cargparse_map_find(&map, "uid", &v), (cargparse_err_e)CARGPARSE_OK);
+    TEST(v.len == 1 && v.str == argv[5] + 14);
+    TEST_EQ(cargparse_map_find(&map, "mode", &v), (cargparse_err_e)CARGPARSE_OK);
+    TEST(v.len == 4 && strncmp(v.str, "0755", 4) == 0);
+    TEST_EQ(cargparse_map_find(&map, "gid", &v), (cargparse_err_e)CARGPARSE_MAP_KEY_NOT_FOUND);
+
+    TEST_EQ(cargparse_get_map_long(&test_map, "opt", &map_linear), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_map_find(&map_linear, "uid", &v), (cargparse_err_e)CARGPARSE_OK);
+    TEST(v.len == 1 && v.str[0] == '0');
+
+    TEST_EQ(cargparse_get_map_long(&test_map, "opt", &map_small), (cargparse_err_e)CARGPARSE_ERR_MAP_FULL);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_map);
+
+    TEST_PARSE_ERROR(&test_map, CARGPARSE_ERR_INVALID_VALUE, "-o", "=1");
+    TEST_PARSE_ERROR(&test_map, CARGPARSE_ERR_INVALID_VALUE, "-o", "a=1,,b=2");
+    TEST_PARSE_ERROR(&test_map, CARGPARSE_ERR_OPTION_NEEDS_ARG, "-o");
+
+    return 0;
+}
+
+int
+test_env_fallback(void) {
+    bool b;
+    long d;
+    const char *s;
+    char *argv[] = {"program", "--level", "3"};
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_env, NULL, NULL, NULL,
+        CARGPARSE_OPTION_INT('l', "level", "level", CARGPARSE_FLAG_REQUIRED | CARGPARSE_FLAG_ENV, 1),
+        CARGPARSE_OPTION_STRING('H', "log-host", "log host", CARGPARSE_FLAG_REQUIRED | CARGPARSE_FLAG_ENV, 1),
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose", CARGPARSE_FLAG_ENV),
+        CARGPARSE_OPTION_STRING('u', "user", "not taken from environment", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_INT('p', "pair", "two numbers", CARGPARSE_FLAG_ENV, 2),
+    );
+    /* clang-format on */
+
+    setenv("CPTEST_LEVEL", "7", 1);
+    setenv("CPTEST_LOG_HOST", "localhost", 1);
+    setenv("CPTEST_VERBOSE", "yes", 1);
+    setenv("CPTEST_USER", "root", 1);
+
+    /* without a prefix the environment is ignored */
+    TEST_PARSE_ERROR(&test_env, CARGPARSE_ERR_NOT_ALL_REQUIRED_OPTIONS, "--level", "3");
+
+    cargparse_set_env_prefix(&test_env, "CPTEST_");
+    TEST_EQ(cargparse_parse(&test_env, sizeof(argv) / sizeof(char *), argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_get_int_long(&test_env, "level", &d, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(d, (long)3);
+    TEST_EQ(cargparse_get_str_long(&test_env, "log-host", &s, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(s, "localhost");
+    TEST_EQ(cargparse_get_bool_short(&test_env, 'v', &b), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(b, (bool)true);
+    TEST_EQ(cargparse_get_str_long(&test_env, "user", &s, "nobody", 0),
+            (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_env);
+
+    TEST_EQ(cargparse_parse(&test_env, 1, argv), (cargparse_err_e)CARGPARSE_GOT_ZERO_ARGS);
+    TEST_EQ(cargparse_get_int_short(&test_env, 'l', &d, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(d, (long)7);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_env);
+
+    setenv("CPTEST_LEVEL", "seven", 1);
+    TEST_PARSE_ERROR(&test_env, CARGPARSE_ERR_INVALID_VALUE, "-H", "remote");
+    setenv("CPTEST_LEVEL", "7", 1);
+
+    /* one variable cannot give the two values of --pair, unless argv gives them */
+    setenv("CPTEST_PAIR", "5", 1);
+    TEST_PARSE_ERROR(&test_env, CARGPARSE_ERR_INVALID_VALUE, "-H", "remote");
+    TEST_EQ_STR(cargparse_get_err_msg(), "Option takes several values, give them in argv: pair");
+    TEST_PARSE_ERROR(&test_env, CARGPARSE_OK, "-H", "remote", "--pair", "1", "2");
+    unsetenv("CPTEST_PAIR");
+
+    unsetenv("CPTEST_LEVEL");
+    unsetenv("CPTEST_LOG_HOST");
+    unsetenv("CPTEST_VERBOSE");
+    unsetenv("CPTEST_USER");
+    return 0;
+}
+
+static int
+write_tmp_file(char *path, const char *content) {
+    int fd = mkstemp(path);
+    if (fd == -1) return -1;
+    if (write(fd, content, strlen(content)) != (ssize_t)strlen(content)) {
+        close(fd);
+        return -1;
+    }
+    return close(fd);
+}
+
+int
+test_config_file(void) {
+    bool b;
+    long d;
+    double f;
+    const char *s;
+    cargparse_source_e src;
+    char path[] = "/tmp/cargparse_test_XXXXXX";
+    char bad_path[] = "/tmp/cargparse_test_XXXXXX";
+    char pair_path[] = "/tmp/cargparse_test_XXXXXX";
+    char *argv[] = {"program", "--name", "from-argv"};
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_cfg, NULL, NULL, NULL,
+        CARGPARSE_OPTION_INT('l', "level", "level", CARGPARSE_FLAG_REQUIRED, 1),
+        CARGPARSE_OPTION_STRING('n', "name", "name", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_FLOAT('r', "ratio", "ratio", CARGPARSE_FLAG_ENV, 1),
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_STRING('t', "title", "title", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_INT('p', "pair", "two numbers", CARGPARSE_FLAG_NONE, 2),
+    );
+    /* clang-format on */
+
+    TEST(write_tmp_file(path, "# generated\n\n  level = 42\nname=from-file\r\nratio = 0.5\n"
+                              "verbose = true\ntitle = \"  spaced  \"") == 0);
+    TEST(write_tmp_file(bad_path, "level = 1\nlevel 2\n") == 0);
+    TEST(write_tmp_file(pair_path, "level = 1\npair = 5\n") == 0);
+
+    TEST_EQ(cargparse_load_config(&test_cfg, "/nonexistent/cargparse.conf"),
+            (cargparse_err_e)CARGPARSE_ERR_CONFIG_IO);
+
+    setenv("CPCFG_RATIO", "2.5", 1);
+    cargparse_set_env_prefix(&test_cfg, "CPCFG_");
+    TEST_EQ(cargparse_load_config(&test_cfg, path), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse(&test_cfg, sizeof(argv) / sizeof(char *), argv), (cargparse_err_e)CARGPARSE_OK);
+
+    TEST_EQ(cargparse_get_int_long(&test_cfg, "level", &d, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(d, (long)42);
+    TEST_EQ(cargparse_get_source_long(&test_cfg, "level", &src), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(src, (cargparse_source_e)CARGPARSE_SOURCE_FILE);
+
+    TEST_EQ(cargparse_get_str_long(&test_cfg, "name", &s, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(s, "from-argv");
+    TEST_EQ(cargparse_get_source_short(&test_cfg, 'n', &src), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(src, (cargparse_source_e)CARGPARSE_SOURCE_ARGV);
+
+    TEST_EQ(cargparse_get_float_long(&test_cfg, "ratio", &f, 0.0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ((long)(f * 10), (long)25);
+    TEST_EQ(cargparse_get_source_long(&test_cfg, "ratio", &src), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(src, (cargparse_source_e)CARGPARSE_SOURCE_ENV);
+
+    TEST_EQ(cargparse_get_bool_long(&test_cfg, "verbose", &b), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(b, (bool)true);
+    TEST_EQ(cargparse_get_str_long(&test_cfg, "title", &s, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(s, "  spaced  ");
+
+    cargparse_unload_config(&test_cfg);
+    TEST_EQ(cargparse_get_source_long(&test_cfg, "level", &src), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(src, (cargparse_source_e)CARGPARSE_SOURCE_NONE);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_cfg);
+
+    TEST_EQ(cargparse_load_config(&test_cfg, bad_path), (cargparse_err_e)CARGPARSE_ERR_CONFIG_SYNTAX);
+    cargparse_unload_config(&test_cfg);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_cfg);
+
+    /* one line cannot give the two values of pair */
+    TEST_EQ(cargparse_load_config(&test_cfg, pair_path), (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+    TEST_EQ_STR(cargparse_get_err_msg(), "Option takes several values, give them in argv: pair");
+    cargparse_unload_config(&test_cfg);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_cfg);
+
+    unsetenv("CPCFG_RATIO");
+    unlink(path);
+    unlink(bad_path);
+    unlink(pair_path);
+    return 0;
+}
+
+int
+test_config_reload(void) {
+    long d;
+    const char *s;
+    const cargparse_t *snap;
+    cargparse_reloader_t reloader;
+    cargparse_reader_t reader;
+    char path[] = "/tmp/cargparse_test_XXXXXX";
+    char next_path[] = "/tmp/cargparse_test_XXXXXX";
+    char *argv[] = {"program", "--name", "from-argv"};
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_rl, NULL, NULL, NULL,
+        CARGPARSE_OPTION_INT('l', "level", "level", CARGPARSE_FLAG_REQUIRED, 1),
+        CARGPARSE_OPTION_STRING('n', "name", "name", CARGPARSE_FLAG_NONE, 1),
+    );
+    /* clang-format on */
+
+    TEST(write_tmp_file(path, "level = 1\nname = from-file\n") == 0);
+    TEST_EQ(cargparse_reloader_init(&reloader, &test_rl, sizeof(argv) / sizeof(char *), argv, path),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_reader_register(&reloader, &reader), (cargparse_err_e)CARGPARSE_OK);
+
+    snap = cargparse_reader_enter(&reader);
+    TEST_EQ(cargparse_get_int_long(snap, "level", &d, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(d, (long)1);
+    TEST_EQ(cargparse_get_str_long(snap, "name", &s, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(s, "from-argv");
+    cargparse_reader_leave(&reader);
+
+    /* the spec itself is never written */
+    TEST_EQ(test_rl.parse_res[0].is_got, (bool)false);
+
+    TEST(write_tmp_file(next_path, "level = 2\n") == 0);
+    TEST(rename(next_path, path) == 0);
+    TEST_EQ(cargparse_reloader_reload(&reloader), (cargparse_err_e)CARGPARSE_OK);
+    snap = cargparse_reader_enter(&reader);
+    TEST_EQ(cargparse_get_int_long(snap, "level", &d, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(d, (long)2);
+    cargparse_reader_leave(&reader);
+
+    /* a broken file keeps the previous snapshot */
+    strcpy(next_path, "/tmp/cargparse_test_XXXXXX");
+    TEST(write_tmp_file(next_path, "level = two\n") == 0);
+    TEST(rename(next_path, path) == 0);
+    TEST_EQ(cargparse_reloader_reload(&reloader), (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+    snap = cargparse_reader_enter(&reader);
+    TEST_EQ(cargparse_get_int_long(snap, "level", &d, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(d, (long)2);
+    cargparse_reader_leave(&reader);
+
+    cargparse_reader_unregister(&reader);
+    cargparse_reloader_destroy(&reloader);
+    unlink(path);
+    return 0;
+}
+
+/* clang-format off */
+CARGPARSE_INIT(cmd_compact, NULL, NULL, NULL,
+    CARGPARSE_OPTION_INT('l', "level", "compaction level", CARGPARSE_FLAG_REQUIRED, 1),
+);
+CARGPARSE_INIT(cmd_dump, NULL, NULL, NULL,
+    CARGPARSE_OPTION_POSITIONAL("table", "table to dump", CARGPARSE_FLAG_REQUIRED, 1),
+);
+CARGPARSE_INIT(cmd_root, NULL, NULL, NULL,
+    CARGPARSE_OPTION_BOOL('v', "verbose", "verbose", CARGPARSE_FLAG_NONE),
+);
+CARGPARSE_COMMANDS(db_commands,
+    CARGPARSE_COMMAND("compact", &cmd_compact),
+    CARGPARSE_COMMAND("dump", &cmd_dump),
+);
+CARGPARSE_COMMANDS(top_commands,
+    CARGPARSE_COMMAND_GROUP("db", NULL, db_commands),
+    CARGPARSE_COMMAND("version", NULL),
+);
+/* clang-format on */
+
+int
+test_subcommands(void) {
+    long d;
+    const char *s;
+    cargparse_command_t *selected;
+    cargparse_command_t root = CARGPARSE_COMMAND_GROUP(NULL, &cmd_root, top_commands);
+    char *argv1[] = {"tool", "db", "compact", "--level", "3"};
+    char *argv2[] = {"tool", "db", "dump", "users"};
+    char *argv3[] = {"tool", "-v"};
+    char *argv4[] = {"tool", "db", "vacuum"};
+    char *argv5[] = {"tool", "db"};
+
+    TEST_EQ(cargparse_parse_command(&root, sizeof(argv1) / sizeof(char *), argv1, &selected),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(selected->name, "compact");
+    TEST_EQ(cargparse_get_int_long(selected->parser, "level", &d, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(d, (long)3);
+    /* only the selected command is prepared */
+    TEST_EQ(cmd_dump.index.is_built, (bool)false);
+    TEST_EQ(cmd_root.index.is_built, (bool)false);
+
+    TEST_EQ(cargparse_parse_command(&root, sizeof(argv2) / sizeof(char *), argv2, &selected),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(selected->name, "dump");
+    TEST_EQ(cargparse_get_positional(selected->parser, "table", &s, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(s, "users");
+
+    TEST_EQ(cargparse_parse_command(&root, sizeof(argv3) / sizeof(char *), argv3, &selected),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST(selected == &root);
+    TEST(cargparse_has_option_short(selected->parser, 'v'));
+
+    TEST_EQ(cargparse_parse_command(&root, sizeof(argv4) / sizeof(char *), argv4, &selected),
+            (cargparse_err_e)CARGPARSE_ERR_SUBCOMMAND_UNKNOWN);
+    TEST_EQ(cargparse_parse_command(&root, sizeof(argv5) / sizeof(char *), argv5, &selected),
+            (cargparse_err_e)CARGPARSE_ERR_SUBCOMMAND_MISSING);
+
+    CARGPARSE_PARSE_RES_CLEANUP(&cmd_compact);
+    CARGPARSE_PARSE_RES_CLEANUP(&cmd_dump);
+    CARGPARSE_PARSE_RES_CLEANUP(&cmd_root);
+    return 0;
+}
+
+/* clang-format off */
+CARGPARSE_INIT(applet_ls, NULL, NULL, NULL,
+    CARGPARSE_OPTION_BOOL('l', "long", "long listing", CARGPARSE_FLAG_NONE),
+    CARGPARSE_OPTION_POSITIONAL("dir", "directory", CARGPARSE_FLAG_NONE, 1),
+);
+CARGPARSE_INIT(applet_cat, NULL, NULL, NULL,
+    CARGPARSE_OPTION_POSITIONAL("file", "file", CARGPARSE_FLAG_REQUIRED, 1),
+);
+CARGPARSE_COMMANDS(applets,
+    CARGPARSE_COMMAND("ls", &applet_ls),
+    CARGPARSE_COMMAND("cat", &applet_cat),
+);
+/* clang-format on */
+
+int
+test_multicall(void) {
+    const char *s;
+    cargparse_command_t *selected;
+    cargparse_command_t registry = CARGPARSE_COMMAND_GROUP(NULL, NULL, applets);
+    char *argv1[] = {"/usr/bin/ls", "-l", "/tmp"};
+    char *argv2[] = {"./box", "cat", "notes.txt"};
+    char *argv3[] = {"box", "rm", "x"};
+    char *argv4[] = {"box"};
+
+    TEST_EQ(cargparse_parse_multicall(&registry, sizeof(argv1) / sizeof(char *), argv1, &selected),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(selected->name, "ls");
+    TEST(cargparse_has_option_short(selected->parser, 'l'));
+    TEST_EQ(cargparse_get_positional(selected->parser, "dir", &s, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(s, "/tmp");
+    TEST_EQ(applet_cat.index.is_built, (bool)false);
+
+    TEST_EQ(cargparse_parse_multicall(&registry, sizeof(argv2) / sizeof(char *), argv2, &selected),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(selected->name, "cat");
+    TEST_EQ(cargparse_get_positional(selected->parser, "file", &s, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(s, "notes.txt");
+
+    TEST_EQ(cargparse_parse_multicall(&registry, sizeof(argv3) / sizeof(char *), argv3, &selected),
+            (cargparse_err_e)CARGPARSE_ERR_SUBCOMMAND_UNKNOWN);
+    TEST_EQ(cargparse_parse_multicall(&registry, sizeof(argv4) / sizeof(char *), argv4, &selected),
+            (cargparse_err_e)CARGPARSE_ERR_SUBCOMMAND_MISSING);
+
+    CARGPARSE_PARSE_RES_CLEANUP(&applet_ls);
+    CARGPARSE_PARSE_RES_CLEANUP(&applet_cat);
+    return 0;
+}
+
+int
+test_generated_parser(void) {
+    gen_tool_args_t args;
+    const char *usages = "Usages: gen_tool [OPTION]... FILE [REST]...\n        gen_tool --help\n\n";
+    char *argv[] = {"gen_tool", "-l", "3", "--ratio", "0.5", "1.5", "-v", "input.txt", "a", "b"};
+
+    /* the index is prebuilt, nothing is set up at parse time */
+    TEST_EQ(gen_tool_parser.index.is_built, (bool)true);
+    TEST_EQ(gen_tool_parser.n_options, 6);
+    TEST_EQ(gen_tool_parser.options[3].nargs, 2);
+    TEST_EQ(gen_tool_parser.options[5].nargs, CARGPARSE_NARGS_ONE_OR_MORE);
+
+    memset(&args, 0, sizeof(args));
+    TEST_EQ(gen_tool_args_parse(&args, sizeof(argv) / sizeof(char *), argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(args.level, (long)3);
+    TEST_EQ(args.level_count, 1u);
+    TEST_EQ(args.verbose, (bool)true);
+    TEST_IS_NULL(args.name);
+    TEST_EQ(args.name_count, 0u);
+    TEST_EQ(args.ratio_count, 2u);
+    TEST(args.ratio[0] == 0.5 && args.ratio[1] == 1.5);
+    TEST_EQ_STR(args.file, "input.txt");
+    TEST_EQ(args.rest_count, 2u);
+    TEST(args.rest == &argv[8]);
+    TEST_EQ_STR(args.rest[1], "b");
+
+    TEST(strncmp(gen_tool_help, usages, strlen(usages)) == 0);
+    TEST(strstr(gen_tool_help, "    INT  -l  --level    compaction level\n") != NULL);
+    TEST(strstr(gen_tool_help, "--name     name of \"something\"\n") != NULL);
+
+    CARGPARSE_PARSE_RES_CLEANUP(&gen_tool_parser);
+    TEST_PARSE_ERROR(&gen_tool_parser, CARGPARSE_ERR_NOT_ALL_REQUIRED_OPTIONS, "-l", "1");
+    TEST_PARSE_ERROR(&gen_tool_parser, CARGPARSE_ERR_OPTION_UNKNOWN, "--levels", "1");
+    return 0;
+}
+
+int
+test_parse_result_blob(void) {
+    long n;
+    double f;
+    bool b;
+    unsigned n_ptrs;
+    size_t blob_size;
+    const char *s;
+    char *ptrs[16], *blob, *copy;
+    cargparse_slice_t v;
+    cargparse_source_e source;
+    char *argv[] = {"program", "-o", "ro,uid=1000", "-n", "7", "--verbose", "-o", "uid=0", "a", "b"};
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_blob, NULL, NULL, NULL,
+        CARGPARSE_OPTION_MAP('o', "opt", "mount-style options", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_INT('n', "number", "number of something", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_FLOAT('f', "float", "some float", CARGPARSE_FLAG_ENV, 1),
+        CARGPARSE_OPTION_POSITIONAL("files", "files", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ONE_OR_MORE),
+    );
+    CARGPARSE_INIT(other_spec, NULL, NULL, NULL,
+        CARGPARSE_OPTION_MAP('o', "opt", "mount-style options", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_INT('n', "number", "number of something", CARGPARSE_FLAG_NONE, 2),
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_FLOAT('f', "float", "some float", CARGPARSE_FLAG_ENV, 1),
+        CARGPARSE_OPTION_POSITIONAL("files", "files", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ONE_OR_MORE),
+    );
+    /* clang-format on */
+    CARGPARSE_MAP_INIT(map, 8);
+
+    setenv("BLOBTEST_FLOAT", "2.5", 1);
+    cargparse_set_env_prefix(&test_blob, "BLOBTEST_");
+    TEST_EQ(cargparse_parse(&test_blob, sizeof(argv) / sizeof(char *), argv), (cargparse_err_e)CARGPARSE_OK);
+    unsetenv("BLOBTEST_FLOAT");
+
+    TEST_EQ(cargparse_blob_write(&test_blob, NULL, 0, &blob_size),
+            (cargparse_err_e)CARGPARSE_ERR_BUFFER_TOO_SMALL);
+    blob = malloc(blob_size);
+    copy = malloc(blob_size);
+    TEST_IS_NOT_NULL(blob);
+    TEST_IS_NOT_NULL(copy);
+    TEST_EQ(cargparse_blob_write(&test_blob, blob, blob_size, &blob_size), (cargparse_err_e)CARGPARSE_OK);
+
+    /* position independent: load a copy, after the original results are gone. The MAP values span six
+     * tokens since its repeats are apart in argv */
+    memcpy(copy, blob, blob_size);
+    memset(blob, 0, blob_size);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_blob);
+    TEST_EQ(cargparse_blob_ptr_count(copy, blob_size, &n_ptrs), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(n_ptrs, 10u);
+    TEST_EQ(cargparse_blob_load(&test_blob, copy, blob_size, ptrs, 9),
+            (cargparse_err_e)CARGPARSE_ERR_BUFFER_TOO_SMALL);
+    TEST_EQ(cargparse_blob_load(&test_blob, copy, blob_size, ptrs, 16), (cargparse_err_e)CARGPARSE_OK);
+
+    TEST_EQ(cargparse_get_int_short(&test_blob, 'n', &n, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(n, 7l);
+    TEST_EQ(cargparse_get_bool_long(&test_blob, "verbose", &b), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(b, (bool)true);
+    TEST_EQ(cargparse_get_float_long(&test_blob, "float", &f, 0.0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST(f == 2.5);
+    TEST_EQ(cargparse_get_source_long(&test_blob, "float", &source), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(source, (cargparse_source_e)CARGPARSE_SOURCE_ENV);
+    TEST_EQ(cargparse_get_positional(&test_blob, "files", &s, NULL, 1), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(s, "b");
+    TEST(s >= copy && s < copy + blob_size);
+
+    /* repeated MAP values keep their layout */
+    TEST_EQ(cargparse_get_map_long(&test_blob, "opt", &map), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(map.n_pairs, 3u);
+    TEST_EQ(cargparse_map_find(&map, "uid", &v), (cargparse_err_e)CARGPARSE_OK);
+    TEST(v.len == 1 && v.str[0] == '0');
+
+    TEST_EQ(cargparse_blob_load(&other_spec, copy, blob_size, ptrs, 16),
+            (cargparse_err_e)CARGPARSE_ERR_BLOB_MISMATCH);
+    TEST_EQ(cargparse_blob_load(&test_blob, copy, blob_size - 1, ptrs, 16),
+            (cargparse_err_e)CARGPARSE_ERR_BLOB_INVALID);
+    TEST_EQ(cargparse_blob_ptr_count(blob, blob_size, &n_ptrs), (cargparse_err_e)CARGPARSE_ERR_BLOB_INVALID);
+
+    /* records are 4 words after a 6 word header, nargs is their third: counts past the tokens of an option
+     * are rejected and leave no results behind */
+    memcpy(blob, copy, blob_size);
+    ((unsigned *)blob)[6 + 4 * 1 + 2] = 5;
+    TEST_EQ(cargparse_blob_load(&test_blob, blob, blob_size, ptrs, 16),
+            (cargparse_err_e)CARGPARSE_ERR_BLOB_INVALID);
+    TEST_EQ(cargparse_get_int_short(&test_blob, 'n', &n, 0, 0), (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
+    memcpy(blob, copy, blob_size);
+    ((unsigned *)blob)[6 + 4 * 0 + 2] = 1;
+    TEST_EQ(cargparse_blob_load(&test_blob, blob, blob_size, ptrs, 16),
+            (cargparse_err_e)CARGPARSE_ERR_BLOB_INVALID);
+
+    CARGPARSE_PARSE_RES_CLEANUP(&test_blob);
+    free(blob);
+    free(copy);
+    return 0;
+}
+
+static bool
+skip_verbose(const cargparse_option_t *const opt, void *ctx) {
+    (void)ctx;
+    return opt->long_name == NULL || strcmp(opt->long_name, "verbose") != 0;
+}
+
+int
+test_emit_argv(void) {
+    int i;
+    long n;
+    double f;
+    char buf[512];
+    cargparse_argv_buf_t out = {NULL, 0, 0, NULL, 0};
+    char *argv[] = {"program", "-o", "ro", "-v", "-n", "7", "-x", "1", "2", "--opt", "uid=0", "a", "b"};
+    const char *expected[] = {"child", "-n", "7", "--opt", "ro", "--opt", "uid=0", "-x", "1", "2", "--", "a",
+                              "b",     NULL};
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_emit, NULL, NULL, NULL,
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_INT('n', CARGPARSE_NO_LONG, "number of something", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_MAP('o', "opt", "mount-style options", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_FLOAT('f', "float", "some float", CARGPARSE_FLAG_ENV, 1),
+        CARGPARSE_OPTION_INT('x', CARGPARSE_NO_LONG, "coordinates", CARGPARSE_FLAG_NONE,
+                             CARGPARSE_NARGS_ONE_OR_MORE),
+        CARGPARSE_OPTION_POSITIONAL("files", "files", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ONE_OR_MORE),
+    );
+    /* clang-format on */
+
+    setenv("EMITTEST_FLOAT", "2.5", 1);
+    cargparse_set_env_prefix(&test_emit, "EMITTEST_");
+    TEST_EQ(cargparse_parse(&test_emit, sizeof(argv) / sizeof(char *), argv), (cargparse_err_e)CARGPARSE_OK);
+    unsetenv("EMITTEST_FLOAT");
+
+    TEST_EQ(cargparse_emit_argv(&test_emit, "child", skip_verbose, NULL, CARGPARSE_EMIT_ARGV, &out),
+            (cargparse_err_e)CARGPARSE_ERR_BUFFER_TOO_SMALL);
+    TEST(out.size <= sizeof(buf));
+    out.buf = buf;
+    out.buf_size = sizeof(buf);
+    TEST_EQ(cargparse_emit_argv(&test_emit, "child", skip_verbose, NULL, CARGPARSE_EMIT_ARGV, &out),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(out.argc, 13);
+    for (i = 0; i <= out.argc; i++) {
+        TEST_EQ_STR(out.argv[i], expected[i]);
+        TEST(out.argv[i] == NULL || (out.argv[i] > buf && out.argv[i] < buf + out.size));
+    }
+
+    /* values resolved outside argv on request, and the vector parses back to the same results */
+    TEST_EQ(cargparse_emit_argv(&test_emit, "child", NULL, NULL, CARGPARSE_EMIT_RESOLVED, &out),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(out.argc, 16);
+    TEST_EQ_STR(out.argv[8], "--float");
+    CARGPARSE_PARSE_RES_CLEANUP(&test_emit);
+    test_emit.env_prefix = NULL;
+    TEST_EQ(cargparse_parse(&test_emit, out.argc, out.argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_get_float_long(&test_emit, "float", &f, 0.0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST(f == 2.5);
+    TEST_EQ(cargparse_get_int_short(&test_emit, 'x', &n, 0, 1), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(n, 2l);
+    TEST(cargparse_has_option_long(&test_emit, "verbose"));
+
+    CARGPARSE_PARSE_RES_CLEANUP(&test_emit);
+    return 0;
+}
+
+int
+test_builder(void) {
+    int i;
+    long n;
+    bool b;
+    char names[100][16];
+    unsigned words[CARGPARSE_INDEX_SIZE(128)];
+    cargparse_option_hot_t hot[100];
+    cargparse_parse_res_t parse_res[100];
+    cargparse_builder_t builder;
+    cargparse_t parser;
+    char *argv[] = {"program", "--opt-42", "42", "-v", "--opt-99", "99"};
+    const cargparse_option_t verbose = CARGPARSE_OPTION_BOOL('v', "verbose", "verbose", CARGPARSE_FLAG_NONE);
+    const cargparse_option_t dup_short = CARGPARSE_OPTION_BOOL('v', "version", "ver", CARGPARSE_FLAG_NONE);
+    const cargparse_option_t dup_long = CARGPARSE_OPTION_INT('n', "opt-7", "number", CARGPARSE_FLAG_NONE, 1);
+
+    cargparse_builder_init(&builder, "program [OPTION]...", NULL, NULL);
+    TEST_EQ(cargparse_builder_add(&builder, &verbose), (cargparse_err_e)CARGPARSE_OK);
+    for (i = 0; i < 99; i++) {
+        cargparse_option_t opt = CARGPARSE_OPTION_INT(CARGPARSE_NO_SHORT, names[i], "plugin option",
+                                                      CARGPARSE_FLAG_NONE, 1);
+        sprintf(names[i], "opt-%d", i + 1);
+        TEST_EQ(cargparse_builder_add(&builder, &opt), (cargparse_err_e)CARGPARSE_OK);
+    }
+    TEST_EQ(cargparse_builder_add(&builder, &dup_short), (cargparse_err_e)CARGPARSE_ERR_INVALID_OPTION);
+    TEST_EQ(cargparse_builder_add(&builder, &dup_long), (cargparse_err_e)CARGPARSE_ERR_INVALID_OPTION);
+    TEST_EQ(builder.n_options, 100);
+    TEST_EQ(builder.max_options, 128);
+
+    TEST_EQ(cargparse_builder_freeze(&builder, &parser), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(parser.n_options, 100);
+    TEST_EQ(parser.index.is_built, (bool)true);
+    TEST_EQ(cargparse_builder_add(&builder, &dup_long), (cargparse_err_e)CARGPARSE_ERR_FROZEN);
+
+    /* the incrementally kept index is the one cargparse_prepare builds */
+    {
+        cargparse_t prepared = {
+            NULL, NULL, NULL, builder.options, parse_res, 100, {words, CARGPARSE_INDEX_SIZE(128), false, hot},
+            NULL, NULL, 0, NULL, NULL, NULL};
+        cargparse_prepare(&prepared);
+        TEST(memcmp(words, parser.index.words, sizeof(words)) == 0);
+        TEST(memcmp(hot, parser.index.hot, sizeof(hot)) == 0);
+    }
+
+    TEST_EQ(cargparse_parse(&parser, sizeof(argv) / sizeof(char *), argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_get_int_long(&parser, "opt-42", &n, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(n, 42l);
+    TEST_EQ(cargparse_get_int_long(&parser, "opt-99", &n, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(n, 99l);
+    TEST_EQ(cargparse_get_bool_short(&parser, 'v', &b), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(b, (bool)true);
+
+    cargparse_builder_destroy(&builder);
+    return 0;
+}
+
+int
+test_render_help(void) {
+    char buf[512];
+    size_t size;
+    const char *expected =
+        "Usages: tool [OPTION]... FILE\n"
+        "        tool --help\n"
+        "\n"
+        "Sorts the lines of FILE and writes them to stdout, keeping\n"
+        "the first of equal lines.\n"
+        "\n"
+        "   BOOL  -v  --verbose            verbose output\n"
+        "    INT      --compression-level  compression level from 0\n"
+        "                                  to 9\n"
+        "    POS                           file to sort\n"
+        "\n"
+        "See also: uniq\n";
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_help, "tool [OPTION]... FILE\ntool --help\n",
+        "Sorts the lines of FILE and writes them to stdout, keeping the first of equal lines.",
+        "See also: uniq",
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_INT(CARGPARSE_NO_SHORT, "compression-level", "compression level from 0 to 9",
+                             CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_POSITIONAL("file", "file to sort", CARGPARSE_FLAG_NONE, 1),
+    );
+    /* clang-format on */
+
+    TEST_EQ(cargparse_render_help(&test_help, 60, NULL, 0, &size),
+            (cargparse_err_e)CARGPARSE_ERR_BUFFER_TOO_SMALL);
+    TEST_EQ(size, strlen(expected) + 1);
+    TEST_EQ(cargparse_render_help(&test_help, 60, buf, size - 1, &size),
+            (cargparse_err_e)CARGPARSE_ERR_BUFFER_TOO_SMALL);
+    TEST_EQ(cargparse_render_help(&test_help, 60, buf, size, &size), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(buf, expected);
+
+    /* wide enough for every line as is */
+    TEST_EQ(cargparse_render_help(&test_help, 120, buf, sizeof(buf), &size), (cargparse_err_e)CARGPARSE_OK);
+    TEST(strstr(buf, "writes them to stdout, keeping the first of equal lines.\n") != NULL);
+    TEST(strstr(buf, "--compression-level  compression level from 0 to 9\n") != NULL);
+    return 0;
+}
+
+int
+test_completion(void) {
+    char buf[256], script[512];
+    size_t size;
+    cargparse_argv_buf_t out = {NULL, 0, 0, NULL, 0};
+    cargparse_command_t root = CARGPARSE_COMMAND_GROUP("tool", &cmd_root, top_commands);
+    char *argv1[] = {"tool", "d"};
+    char *argv2[] = {"tool", "db", "compact", "--le"};
+    char *argv3[] = {"tool", "db", "dump", "--", "-"};
+    char *argv4[] = {"tool", "db", "compact", "-l", "3"};
+    char *argv5[] = {"tool", "-"};
+
+    TEST_EQ(cargparse_complete_command(&root, 2, argv1, 1, &out),
+            (cargparse_err_e)CARGPARSE_ERR_BUFFER_TOO_SMALL);
+    out.buf = buf;
+    out.buf_size = sizeof(buf);
+    TEST_EQ(cargparse_complete_command(&root, 2, argv1, 1, &out), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(out.argc, 1);
+    TEST_EQ_STR(out.argv[0], "db");
+
+    /* a new word after a group, sorted */
+    TEST_EQ(cargparse_complete_command(&root, 2, argv2, 2, &out), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(out.argc, 2);
+    TEST_EQ_STR(out.argv[0], "compact");
+    TEST_EQ_STR(out.argv[1], "dump");
+    TEST_IS_NULL(out.argv[2]);
+
+    TEST_EQ(cargparse_complete_command(&root, 4, argv2, 3, &out), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(out.argc, 1);
+    TEST_EQ_STR(out.argv[0], "--level");
+    TEST_EQ(cargparse_complete_command(&root, 5, argv3, 4, &out), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(out.argc, 0);
+    TEST_EQ(cargparse_complete_command(&root, 5, argv4, 4, &out), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(out.argc, 0);
+    TEST_EQ(cargparse_complete_command(&root, 5, argv4, 6, &out),
+            (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+
+    TEST_EQ(cargparse_complete(&cmd_root, 2, argv5, 1, &out), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(out.argc, 2);
+    TEST_EQ_STR(out.argv[0], "--verbose");
+    TEST_EQ_STR(out.argv[1], "-v");
+
+    TEST_EQ(cargparse_handle_completion(&root, 5, argv4), (bool)false);
+
+    TEST_EQ(cargparse_completion_script(CARGPARSE_SHELL_BASH, "my-tool", script, sizeof(script), &size),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(size, strlen(script) + 1);
+    TEST(strstr(script, "complete -o default -F _cargparse_my_tool my-tool\n") != NULL);
+    TEST_EQ(cargparse_completion_script(CARGPARSE_SHELL_FISH, "my-tool", script, sizeof(script), &size),
+            (cargparse_err_e)CARGPARSE_OK);
+    TEST(strncmp(script, "complete -c my-tool -a '(my-tool __complete ", 44) == 0);
+    TEST_EQ(cargparse_completion_script(CARGPARSE_SHELL_ZSH, "my tool", script, sizeof(script), &size),
+            (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+    return 0;
+}
+
+int
+test_suggest_option(void) {
+    /* clang-format off */
+    CARGPARSE_INIT(test_suggest, NULL, NULL, NULL,
+        CARGPARSE_OPTION_INT('l', "level", "compaction level", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_INT(CARGPARSE_NO_SHORT, "levels", "number of levels", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_STRING(CARGPARSE_NO_SHORT, "compression", "codec", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_POSITIONAL("file", "input file", CARGPARSE_FLAG_NONE, 1),
+    );
+    /* clang-format on */
+
+    /* before and after the index is built */
+    TEST_EQ_STR(cargparse_suggest_option(&test_suggest, "lvel"), "level");
+    cargparse_prepare(&test_suggest);
+    TEST_EQ(test_suggest.index.is_built, (bool)true);
+    TEST_EQ_STR(cargparse_suggest_option(&test_suggest, "lvel"), "level");
+
+    TEST_EQ_STR(cargparse_suggest_option(&test_suggest, "levle"), "level");
+    TEST_EQ_STR(cargparse_suggest_option(&test_suggest, "levelss"), "levels");
+    TEST_EQ_STR(cargparse_suggest_option(&test_suggest, "verbsoe"), "verbose");
+    TEST_EQ_STR(cargparse_suggest_option(&test_suggest, "compresion"), "compression");
+    TEST_EQ_STR(cargparse_suggest_option(&test_suggest, "cmprssion"), "compression");
+    TEST_IS_NULL(cargparse_suggest_option(&test_suggest, "cmprsion"));
+    TEST_IS_NULL(cargparse_suggest_option(&test_suggest, "xyz"));
+    /* positionals are not named on the command line */
+    TEST_IS_NULL(cargparse_suggest_option(&test_suggest, "fil"));
+
+    TEST_PARSE_ERROR(&test_suggest, CARGPARSE_ERR_OPTION_UNKNOWN, "--levle", "3", "input");
+    return 0;
+}
+
+#ifdef CARGPARSE_TRACE
+typedef struct {
+    int events[4];
+    int matched[8];
+    int n_matched;
+    const char *converted;
+    int error;
+} trace_log_t;
+
+static void
+_trace_log(const cargparse_t *const parser, const cargparse_trace_event_e event, const int opt_idx,
+           const char *arg, const int detail, void *ctx) {
+    trace_log_t *log = ctx;
+
+    (void)parser;
+    log->events[event]++;
+    if (event == CARGPARSE_TRACE_MATCH && log->n_matched < 8) log->matched[log->n_matched++] = opt_idx;
+    if (event == CARGPARSE_TRACE_CONVERT) log->converted = arg;
+    if (event == CARGPARSE_TRACE_ERROR) log->error = detail;
+}
+
+int
+test_trace(void) {
+    long level;
+    bool quiet;
+    cargparse_trace_t trace;
+    trace_log_t log;
+    char *argv[] = {"program", "--level", "3", "-v", "input"};
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_trc, NULL, NULL, NULL,
+        CARGPARSE_OPTION_INT('l', "level", "compaction level", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_BOOL('q', "quiet", "no output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_POSITIONAL("file", "input file", CARGPARSE_FLAG_NONE, 1),
+    );
+    /* clang-format on */
+
+    memset(&log, 0, sizeof(log));
+    TEST_IS_NULL(test_trc.trace);
+    cargparse_set_trace(&test_trc, &trace, _trace_log, &log);
+    TEST_EQ(trace.phase, -1);
+
+    TEST_EQ(cargparse_parse(&test_trc, 5, argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(trace.tokens, 4UL);
+    TEST_EQ(trace.lookups, 2UL);
+    TEST_EQ(log.events[CARGPARSE_TRACE_TOKEN], 4);
+    TEST_EQ(log.n_matched, 2);
+    TEST_EQ(log.matched[0], 0);
+    TEST_EQ(log.matched[1], 1);
+    TEST_EQ(trace.phase, -1);
+
+    TEST_EQ(cargparse_get_int_long(&test_trc, "level", &level, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(level, 3L);
+    TEST_EQ_STR(log.converted, "3");
+    /* defaults are not conversions */
+    TEST_EQ(cargparse_get_bool_short(&test_trc, 'q', &quiet), (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
+    TEST_EQ(trace.conversions, 1UL);
+    TEST_EQ(trace.lookups, 4UL);
+    TEST_EQ(trace.errors, 0UL);
+
+    TEST_EQ(cargparse_get_int_long(&test_trc, "levels", &level, 0, 0),
+            (cargparse_err_e)CARGPARSE_ERR_OPTION_UNKNOWN);
+    TEST_EQ(trace.errors, 1UL);
+    TEST_EQ(log.error, (int)CARGPARSE_ERR_OPTION_UNKNOWN);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_trc);
+
+    TEST_PARSE_ERROR(&test_trc, CARGPARSE_ERR_OPTION_NEEDS_ARG, "--level");
+    TEST_EQ(trace.errors, 2UL);
+    TEST_EQ(log.error, (int)CARGPARSE_ERR_OPTION_NEEDS_ARG);
+    TEST_EQ(log.events[CARGPARSE_TRACE_ERROR], 2);
+
+    /* detached parsers are not counted */
+    cargparse_set_trace(&test_trc, NULL, NULL, NULL);
+    TEST_PARSE_ERROR(&test_trc, CARGPARSE_OK, "-q");
+    TEST_EQ(trace.tokens, 5UL);
+    return 0;
+}
+#endif
+
+static int getopt_flag;
+
+static const struct option GETOPT_LONGOPTS[] = {
+    {"level", required_argument, NULL, 'l'},
+    {"verbose", no_argument, NULL, 'v'},
+    {"color", optional_argument, NULL, 'c'},
+    {"colour", optional_argument, NULL, 'c'},
+    {"dry-run", no_argument, &getopt_flag, 7},
+    {"debug", no_argument, NULL, 'd'},
+    {"verbose", required_argument, NULL, 'V'},
+    {NULL, 0, NULL, 0},
+};
+
+/* Walks argv with glibc getopt_long and the shim side by side, twice: the second walk restarts the same
+ * state with optind = 0, which keeps opterr */
+static int
+_getopt_compare(const char *optstring, char **argv, const int argc) {
+    int c, walk, theirs_idx = -1, ours_idx = -1;
+    char *theirs[16], *ours[16];
+    cargparse_getopt_spec_t spec;
+    cargparse_getopt_state_t state = CARGPARSE_GETOPT_STATE_INIT;
+
+    TEST_EQ(cargparse_getopt_compile(&spec, optstring, GETOPT_LONGOPTS), (cargparse_err_e)CARGPARSE_OK);
+    state.opterr = 0;
+    opterr = 0;
+    for (walk = 0; walk < 2; walk++) {
+        memcpy(theirs, argv, sizeof(char *) * (size_t)argc);
+        memcpy(ours, argv, sizeof(char *) * (size_t)argc);
+        state.optind = 0;
+        optind = 0;
+        do {
+            c = getopt_long(argc, theirs, optstring, GETOPT_LONGOPTS, &theirs_idx);
+            TEST_EQ(cargparse_getopt_long(&spec, &state, argc, ours, &ours_idx), c);
+            TEST_EQ(state.optind, optind);
+            TEST_EQ_STR(state.optarg, optarg);
+            TEST_EQ(ours_idx, theirs_idx);
+            TEST_EQ(state.opterr, 0);
+            if (c == '?' || c == ':') TEST_EQ(state.optopt, optopt);
+        } while (c != -1);
+        TEST(memcmp(theirs, ours, sizeof(char *) * (size_t)argc) == 0);
+    }
+    cargparse_getopt_destroy(&spec);
+    return 0;
+}
+
+int
+test_getopt_long(void) {
+    size_t i, j;
+    static const char *const OPTSTRINGS[] = {"l:vc::x", "+l:vc::x", "-l:vc::x", ":l:vc::x", "vvl:"};
+    char *argv1[] = {"prog", "in1", "--level", "3", "-vx", "in2", "--col=red", "-lfast", "--", "-v"};
+    char *argv2[] = {"prog", "-c", "--colo", "--verb", "--dry", "in", "-cblue", "-l"};
+    char *argv3[] = {"prog", "--d", "--unknown", "-z", "--verbose=1", "--level=", "x", "--level"};
+    char *argv4[] = {"prog", "-vl", "5", "a", "-", "b", "--dry-run", "c", "-xv"};
+    char *argv5[] = {"prog", "a", "b"};
+    struct {
+        char **argv;
+        int argc;
+    } cases[] = {{argv1, 10}, {argv2, 8}, {argv3, 8}, {argv4, 9}, {argv5, 3}};
+
+    getopt_flag = 0;
+    for (i = 0; i < sizeof(OPTSTRINGS) / sizeof(*OPTSTRINGS); i++) {
+        for (j = 0; j < sizeof(cases) / sizeof(*cases); j++) {
+            TEST(_getopt_compare(OPTSTRINGS[i], cases[j].argv, cases[j].argc) == 0);
+        }
+    }
+    TEST_EQ(getopt_flag, 7);
+    return 0;
+}
+
+/* Option groups of test_parse_properties, an option token with all its values in two spellings */
+static const char *const PROP_GROUPS[][2][5] = {
+    {{"-a", NULL}, {"--alpha", NULL}},
+    {{"-b", NULL}, {"--beta", NULL}},
+    {{"-n", "7", NULL}, {"--num", "7", NULL}},
+    {{"-p", "1", "2", NULL}, {"--pair", "1", "2", NULL}},
+    {{"-s", "val", NULL}, {"--str", "val", NULL}},
+    {{"-x", "4", "5", "6", NULL}, {"--xs", "4", "5", "6", NULL}},
+};
+
+#define PROP_N_GROUPS (int)(sizeof(PROP_GROUPS) / sizeof(*PROP_GROUPS))
+#define PROP_MAX_ARGC 32
+
+static unsigned long prop_seed = 1;
+
+static int
+_prop_rand(const int n) {
+    prop_seed = prop_seed * 1103515245UL + 12345UL;
+    return (int)((prop_seed >> 16) % (unsigned long)n);
+}
+
+/* Everything the parse wrote, as one string to compare runs */
+static void
+_prop_fingerprint(const cargparse_t *const parser, char *buf) {
+    int i, j;
+
+    *buf = '\0';
+    for (i = 0; i < parser->n_options; i++) {
+        buf += sprintf(buf, "%d:%d", parser->parse_res[i].is_got, parser->parse_res[i].nargs);
+        for (j = 0; j < parser->parse_res[i].nargs && parser->parse_res[i].valuestr; j++) {
+            buf += sprintf(buf, ",%s", parser->parse_res[i].valuestr[j]);
+        }
+        *buf++ = '|';
+    }
+    *buf = '\0';
+}
+
+/* Writes the groups in `order` to `argv`, `cut` tokens into group `cut_group` when it is not -1, and
+ * `inject` right after the option token of that group when it is not NULL. Returns argc. */
+static int
+_prop_build_argv(char **argv, const int *order, const int *spelling, const int n, const int cut_group,
+                 const int cut, const char *inject) {
+    int i, j, argc = 1;
+    const char *const *group;
+
+    argv[0] = "program";
+    for (i = 0; i < n; i++) {
+        group = PROP_GROUPS[order[i]][spelling[order[i]]];
+        for (j = 0; group[j]; j++) {
+            if (order[i] == cut_group && j == cut) return argc;
+            argv[argc++] = (char *)group[j];
+            if (order[i] == cut_group && j == 0 && inject) argv[argc++] = (char *)inject;
+        }
+    }
+    /* after "--" everything is positional, option-like or empty */
+    argv[argc++] = "--";
+    argv[argc++] = "in";
+    argv[argc++] = "-a";
+    argv[argc++] = "";
+    return argc;
+}
+
+int
+test_parse_properties(void) {
+    int round, i, j, tmp, n, argc, order[PROP_N_GROUPS], spelling[PROP_N_GROUPS];
+    char *argv[PROP_MAX_ARGC];
+    char expected[1024], got[1024];
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_prop, NULL, NULL, NULL,
+        CARGPARSE_OPTION_BOOL('a', "alpha", "a flag", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_BOOL('b', "beta", "b flag", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_INT('n', "num", "a number", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_INT('p', "pair", "two numbers", CARGPARSE_FLAG_NONE, 2),
+        CARGPARSE_OPTION_STRING('s', "str", "a string", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_INT('x', "xs", "some numbers", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ONE_OR_MORE),
+        CARGPARSE_OPTION_POSITIONAL("files", "files", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ZERO_OR_MORE),
+    );
+    /* clang-format on */
+
+    for (round = 0; round < 200; round++) {
+        n = 1 + _prop_rand(PROP_N_GROUPS);
+        for (i = 0; i < PROP_N_GROUPS; i++) {
+            order[i] = i;
+            spelling[i] = _prop_rand(2);
+        }
+        for (i = PROP_N_GROUPS - 1; i > 0; i--) {
+            j = _prop_rand(i + 1);
+            tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+
+        /* the order of the groups and the spelling of names do not change the results */
+        argc = _prop_build_argv(argv, order, spelling, n, -1, 0, NULL);
+        TEST_EQ(cargparse_parse(&test_prop, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+        _prop_fingerprint(&test_prop, expected);
+        CARGPARSE_PARSE_RES_CLEANUP(&test_prop);
+        for (i = 0; i < n; i++) {
+            spelling[order[i]] ^= 1;
+        }
+        tmp = order[0];
+        memmove(order, order + 1, sizeof(int) * (size_t)(n - 1));
+        order[n - 1] = tmp;
+        argc = _prop_build_argv(argv, order, spelling, n, -1, 0, NULL);
+        TEST_EQ(cargparse_parse(&test_prop, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+        _prop_fingerprint(&test_prop, got);
+        CARGPARSE_PARSE_RES_CLEANUP(&test_prop);
+        TEST_EQ_STR(got, expected);
+
+        /* a fixed nargs option missing values, or followed by another option or "--", needs its argument */
+        for (i = 0; i < n; i++) {
+            if (order[i] < 2 || order[i] == 5) continue;
+            j = 1 + _prop_rand(order[i] == 3 ? 2 : 1);
+            argc = _prop_build_argv(argv, order, spelling, i + 1, order[i], j, NULL);
+            TEST_EQ(cargparse_parse(&test_prop, argc, argv), (cargparse_err_e)CARGPARSE_ERR_OPTION_NEEDS_ARG);
+            CARGPARSE_PARSE_RES_CLEANUP(&test_prop);
+            argc = _prop_build_argv(argv, order, spelling, n, order[i], -1, _prop_rand(2) ? "-a" : "--");
+            TEST_EQ(cargparse_parse(&test_prop, argc, argv), (cargparse_err_e)CARGPARSE_ERR_OPTION_NEEDS_ARG);
+            CARGPARSE_PARSE_RES_CLEANUP(&test_prop);
+        }
+    }
+    return 0;
+}
+
+int
+test_parse_stream(void) {
+    int first, second;
+    char expected[1024], got[1024];
+    char *argv[] = {"program", "-p", "1", "2", "-x", "3", "4", "--rate", "5", "-v", "--", "f", "-v"};
+    const int argc = sizeof(argv) / sizeof(char *);
+    cargparse_stream_t stream;
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_stream, NULL, NULL, NULL,
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_INT('p', "pair", "two numbers", CARGPARSE_FLAG_NONE, 2),
+        CARGPARSE_OPTION_INT('x', "xs", "some numbers", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ONE_OR_MORE),
+        CARGPARSE_OPTION_INT('r', "rate", "rate", CARGPARSE_FLAG_REQUIRED, 1),
+        CARGPARSE_OPTION_POSITIONAL("files", "files", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ZERO_OR_MORE),
+    );
+    /* clang-format on */
+
+    TEST_EQ(cargparse_parse(&test_stream, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+    _prop_fingerprint(&test_stream, expected);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_stream);
+
+    /* any split of argv into three feeds gives the results of one parse */
+    for (first = 1; first <= argc; first++) {
+        for (second = first; second <= argc; second++) {
+            TEST_EQ(cargparse_parse_begin(&stream, &test_stream), (cargparse_err_e)CARGPARSE_OK);
+            TEST_EQ(cargparse_parse_feed(&stream, first, argv), (cargparse_err_e)CARGPARSE_OK);
+            TEST_EQ(cargparse_parse_feed(&stream, second, argv), (cargparse_err_e)CARGPARSE_OK);
+            TEST_EQ(cargparse_parse_feed(&stream, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+            TEST_EQ(stream.n_tokens, argc);
+            TEST_EQ(cargparse_parse_finish(&stream), (cargparse_err_e)CARGPARSE_OK);
+            _prop_fingerprint(&test_stream, got);
+            CARGPARSE_PARSE_RES_CLEANUP(&test_stream);
+            TEST_EQ_STR(got, expected);
+        }
+    }
+
+    /* the pending option and the required ones are only checked by finish, and errors stick */
+    TEST_EQ(cargparse_parse_begin(&stream, &test_stream), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse_feed(&stream, 3, argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(stream.opt_idx, 1);
+    TEST_EQ(cargparse_parse_finish(&stream), (cargparse_err_e)CARGPARSE_ERR_OPTION_NEEDS_ARG);
+    TEST_EQ(cargparse_parse_feed(&stream, argc, argv), (cargparse_err_e)CARGPARSE_ERR_OPTION_NEEDS_ARG);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_stream);
+
+    TEST_EQ(cargparse_parse_begin(&stream, &test_stream), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse_feed(&stream, 7, argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse_feed(&stream, 4, argv), (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_stream);
+
+    TEST_EQ(cargparse_parse_begin(&stream, &test_stream), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse_feed(&stream, 4, argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse_finish(&stream), (cargparse_err_e)CARGPARSE_ERR_NOT_ALL_REQUIRED_OPTIONS);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_stream);
+
+    TEST_EQ(cargparse_parse_begin(&stream, &test_stream), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse_feed(&stream, 1, argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse_finish(&stream), (cargparse_err_e)CARGPARSE_GOT_ZERO_ARGS);
+    TEST_EQ(cargparse_parse_feed(NULL, argc, argv), (cargparse_err_e)CARGPARSE_ERR_NULL_PARSER);
+    return 0;
+}
+
+int
+test_event_log(void) {
+    unsigned i, cursor = 0;
+    cargparse_event_t events[9], few[4];
+    cargparse_event_log_t log = {events, 0, 9}, short_log = {few, 0, 4};
+    const cargparse_event_t *event;
+    const cargparse_event_t expected[] = {{0, 1, -1}, {1, 1, -1}, {2, 2, -1}, {2, 3, 0}, {3, 4, -1},
+                                          {3, 5, 0},  {3, 6, 1},  {4, 8, 0},  {4, 9, 1}};
+    char *argv[] = {"program", "-vq", "--level", "3", "-x", "1", "2", "--", "a", "b"};
+    const int argc = sizeof(argv) / sizeof(char *);
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_ev, NULL, NULL, NULL,
+        CARGPARSE_OPTION_BOOL('v', "verbose", "verbose output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_BOOL('q', "quiet", "no output", CARGPARSE_FLAG_NONE),
+        CARGPARSE_OPTION_INT('l', "level", "level", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_INT('x', "xs", "some numbers", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ONE_OR_MORE),
+        CARGPARSE_OPTION_POSITIONAL("files", "files", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ZERO_OR_MORE),
+        CARGPARSE_OPTION_FLOAT('f', "float", "from the environment", CARGPARSE_FLAG_ENV, 1),
+    );
+    /* clang-format on */
+
+    setenv("EVTEST_FLOAT", "2.5", 1);
+    cargparse_set_env_prefix(&test_ev, "EVTEST_");
+    cargparse_set_event_log(&test_ev, &log);
+    TEST_EQ(cargparse_parse(&test_ev, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+    unsetenv("EVTEST_FLOAT");
+    test_ev.env_prefix = NULL;
+    CARGPARSE_PARSE_RES_CLEANUP(&test_ev);
+
+    /* one event per option name and value in argv order, none for "--" or the environment */
+    TEST_EQ(log.n_events, 9U);
+    for (i = 0; (event = cargparse_event_next(&log, &cursor)); i++) {
+        TEST_EQ(event->opt_idx, expected[i].opt_idx);
+        TEST_EQ(event->argv_idx, expected[i].argv_idx);
+        TEST_EQ(event->value_idx, expected[i].value_idx);
+    }
+    TEST_EQ(i, 9U);
+
+    /* a short log counts what it could not store */
+    cargparse_set_event_log(&test_ev, &short_log);
+    TEST_EQ(cargparse_parse(&test_ev, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_ev);
+    TEST_EQ(short_log.n_events, 9U);
+    for (cursor = 0, i = 0; cargparse_event_next(&short_log, &cursor); i++) {
+    }
+    TEST_EQ(i, 4U);
+    TEST_EQ(few[3].argv_idx, 3);
+
+    /* a new parse starts over */
+    TEST_EQ(cargparse_parse(&test_ev, 3, argv), (cargparse_err_e)CARGPARSE_ERR_OPTION_NEEDS_ARG);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_ev);
+    TEST_EQ(short_log.n_events, 3U);
+
+    cargparse_set_event_log(&test_ev, NULL);
+    TEST_EQ(cargparse_parse(&test_ev, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_ev);
+    TEST_EQ(short_log.n_events, 3U);
+    return 0;
+}
+
+int
+test_lazy_values(void) {
+    long level, x;
+    double ratio;
+    char level_str[] = "3";
+    char *argv[] = {"program", "--level", level_str, "--ratio", "0.5", "-x", "1", "oops"};
+    const int argc = sizeof(argv) / sizeof(char *);
+    cargparse_lazy_value_t values[7];
+    cargparse_lazy_t lazy = {values, 7, NULL, 0, 0};
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_lz, NULL, NULL, NULL,
+        CARGPARSE_OPTION_INT('l', "level", "level", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_FLOAT('r', "ratio", "ratio", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_INT('x', "xs", "some numbers", CARGPARSE_FLAG_NONE, 2),
+    );
+    /* clang-format on */
+
+    /* a malformed number fails the parse only without the lazy mode */
+    TEST_EQ(cargparse_parse(&test_lz, argc, argv), (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_lz);
+    cargparse_set_lazy(&test_lz, &lazy);
+    TEST_EQ(cargparse_parse(&test_lz, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+
+    TEST_EQ(cargparse_get_int_long(&test_lz, "level", &level, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(level, 3L);
+    TEST_EQ(cargparse_get_float_long(&test_lz, "ratio", &ratio, 0.0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(ratio, 0.5);
+    TEST_EQ(cargparse_get_int_short(&test_lz, 'x', &x, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(x, 1L);
+
+    /* the malformed value fails on every read and leaves the result alone, argv[7] is past max_values */
+    TEST_EQ(cargparse_get_int_short(&test_lz, 'x', &x, 0, 1), (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+    TEST_EQ(cargparse_get_int_short(&test_lz, 'x', &x, 0, 1), (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+    TEST_EQ(x, 1L);
+    TEST_EQ(cargparse_check_values(&test_lz), (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+
+    /* converted values are kept until the next parse */
+    level_str[0] = '7';
+    TEST_EQ(cargparse_get_int_long(&test_lz, "level", &level, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(level, 3L);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_lz);
+    argv[7] = "2";
+    TEST_EQ(cargparse_parse(&test_lz, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_check_values(&test_lz), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_get_int_long(&test_lz, "level", &level, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(level, 7L);
+    TEST_EQ(cargparse_get_int_short(&test_lz, 'x', &x, 0, 1), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(x, 2L);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_lz);
+
+    /* back to checking at parse time */
+    cargparse_set_lazy(&test_lz, NULL);
+    argv[4] = "half";
+    TEST_EQ(cargparse_parse(&test_lz, argc, argv), (cargparse_err_e)CARGPARSE_ERR_INVALID_VALUE);
+    CARGPARSE_PARSE_RES_CLEANUP(&test_lz);
+    return 0;
+}
+
+int
+test_split_line(void) {
+    int argc;
+    long rate;
+    const char *name;
+    char *argv[10], *argv_b[8];
+    char line[] = "set  --rate 1000\t--name 'a b'\"c\\\"d\"e\\ f -- \"\" x\\$y\n";
+    char quoted[] = "say \"\\a\\\\\" '\\n'";
+    char open[] = "set --name 'a b", trailing[] = "set x\\", many[] = "a b c d e f g h i", blank[] = " \t\n";
+    cargparse_parse_res_t res_a[3], res_b[3];
+    cargparse_t conn_a, conn_b;
+
+    /* clang-format off */
+    CARGPARSE_INIT(test_line, NULL, NULL, NULL,
+        CARGPARSE_OPTION_INT('r', "rate", "rate", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_STRING('n', "name", "name", CARGPARSE_FLAG_NONE, 1),
+        CARGPARSE_OPTION_POSITIONAL("args", "arguments", CARGPARSE_FLAG_NONE, CARGPARSE_NARGS_ZERO_OR_MORE),
+    );
+    /* clang-format on */
+
+    TEST_EQ(cargparse_split_line(line, argv, 10, &argc), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(argc, 8);
+    TEST_EQ_STR(argv[0], "set");
+    TEST_EQ_STR(argv[1], "--rate");
+    TEST_EQ_STR(argv[2], "1000");
+    TEST_EQ_STR(argv[3], "--name");
+    TEST_EQ_STR(argv[4], "a bc\"de f");
+    TEST_EQ_STR(argv[5], "--");
+    TEST_EQ_STR(argv[6], "");
+    TEST_EQ_STR(argv[7], "x$y");
+    TEST_IS_NULL(argv[8]);
+
+    /* words live in the line itself */
+    TEST(argv[4] > line && argv[4] < line + sizeof(line));
+    TEST_EQ(cargparse_split_line(quoted, argv, 8, &argc), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(argc, 3);
+    TEST_EQ_STR(argv[1], "\\a\\");
+    TEST_EQ_STR(argv[2], "\\n");
+
+    /* each line reports its own error, not the first one of the thread */
+    TEST_EQ(cargparse_split_line(open, argv, 8, &argc), (cargparse_err_e)CARGPARSE_ERR_LINE_SYNTAX);
+    TEST_EQ_STR(cargparse_get_err_msg(), "Unterminated quote");
+    TEST_EQ(cargparse_split_line(trailing, argv, 8, &argc), (cargparse_err_e)CARGPARSE_ERR_LINE_SYNTAX);
+    TEST_EQ_STR(cargparse_get_err_msg(), "Backslash at the end of the line");
+    TEST_EQ(cargparse_split_line(many, argv, 8, &argc), (cargparse_err_e)CARGPARSE_ERR_BUFFER_TOO_SMALL);
+    TEST_EQ(argc, 9);
+    TEST_EQ(cargparse_split_line(blank, NULL, 0, &argc), (cargparse_err_e)CARGPARSE_ERR_BUFFER_TOO_SMALL);
+    TEST_EQ(argc, 0);
+    TEST_EQ(cargparse_split_line(blank, argv, 1, &argc), (cargparse_err_e)CARGPARSE_OK);
+    TEST_IS_NULL(argv[0]);
+
+    /* two connections bound to one spec keep their own results, which point into their own line and argv */
+    TEST_EQ(cargparse_bind(&conn_a, &test_line, res_a), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_bind(&conn_b, &test_line, res_b), (cargparse_err_e)CARGPARSE_OK);
+    strcpy(line, "set --rate 10 --name first");
+    TEST_EQ(cargparse_split_line(line, argv, 8, &argc), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse(&conn_a, argc, argv), (cargparse_err_e)CARGPARSE_OK);
+    strcpy(quoted, "set -r 20 'x y'");
+    TEST_EQ(cargparse_split_line(quoted, argv_b, 8, &argc), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(cargparse_parse(&conn_b, argc, argv_b), (cargparse_err_e)CARGPARSE_OK);
+
+    TEST_EQ(cargparse_get_int_long(&conn_a, "rate", &rate, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(rate, 10L);
+    TEST_EQ(cargparse_get_str_long(&conn_a, "name", &name, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(name, "first");
+    TEST_EQ(cargparse_get_int_long(&conn_b, "rate", &rate, 0, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ(rate, 20L);
+    TEST_EQ(cargparse_get_str_long(&conn_b, "name", &name, NULL, 0),
+            (cargparse_err_e)CARGPARSE_DEFAULT_VALUE);
+    TEST_EQ(cargparse_get_positional(&conn_b, "args", &name, NULL, 0), (cargparse_err_e)CARGPARSE_OK);
+    TEST_EQ_STR(name, "x y");
+    TEST(!test_line.parse_res[0].is_got);
+    return 0;
+}
+
 int
 main(void) {
     printf("\nRunning tests...\n");
@@ -415,6 +1718,28 @@ main(void) {
     RUN_TEST(test_argparse_getters_unknown);
     RUN_TEST(test_argparse_getters_defaults);
     RUN_TEST(test_required_args);
+    RUN_TEST(test_map_option);
+    RUN_TEST(test_env_fallback);
+    RUN_TEST(test_config_file);
+    RUN_TEST(test_config_reload);
+    RUN_TEST(test_subcommands);
+    RUN_TEST(test_multicall);
+    RUN_TEST(test_generated_parser);
+    RUN_TEST(test_parse_result_blob);
+    RUN_TEST(test_emit_argv);
+    RUN_TEST(test_builder);
+    RUN_TEST(test_render_help);
+    RUN_TEST(test_completion);
+    RUN_TEST(test_suggest_option);
+    RUN_TEST(test_getopt_long);
+    RUN_TEST(test_parse_properties);
+    RUN_TEST(test_parse_stream);
+    RUN_TEST(test_event_log);
+    RUN_TEST(test_lazy_values);
+    RUN_TEST(test_split_line);
+#ifdef CARGPARSE_TRACE
+    RUN_TEST(test_trace);
+#endif
 
     print_test_summary();
 
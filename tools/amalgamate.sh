@@ -0,0 +1,56 @@
+#!/bin/sh
+# Writes the single-header build of cargparse.h and cargparse.c to stdout, see `make single`.
+#
+# Public functions get a CARGPARSE_DEF specifier, found by the repo style of the return type on the line
+# before a name starting in column 0: extern by default, static __inline__ with CARGPARSE_STATIC so
+# getters and lookups are inlined and constant option names propagate into them.
+set -e
+
+header=${1:-cargparse.h}
+source=${2:-cargparse.c}
+
+# prefixes the return type line of every cargparse_*() declaration or definition
+mark_api() {
+    awk '
+        NR > 1 {
+            if ($0 ~ /^cargparse_[a-z0-9_]*\(/ && prev !~ /^[ #\/*]/ && prev != "" && prev !~ /[;{}]/) {
+                prev = "CARGPARSE_DEF " prev
+            }
+            print prev
+        }
+        { prev = $0 }
+        END { if (NR > 0) print prev }
+    ' "$1"
+}
+
+cat <<'EOF'
+/* cargparse single-header build, generated by tools/amalgamate.sh, do not edit.
+ *
+ * Include it everywhere in place of cargparse.h, and in exactly one file after
+ *
+ *     #define CARGPARSE_IMPLEMENTATION
+ *
+ * or in every file that uses it after `#define CARGPARSE_STATIC`, which makes the whole library static
+ * inline in that file. The implementation needs _DEFAULT_SOURCE, so include it first or define that before
+ * any system header. */
+#ifndef CARGPARSE_SINGLE_H
+#define CARGPARSE_SINGLE_H
+
+#ifdef CARGPARSE_STATIC
+#define CARGPARSE_DEF static __inline__
+#ifndef CARGPARSE_IMPLEMENTATION
+#define CARGPARSE_IMPLEMENTATION
+#endif
+#else
+#define CARGPARSE_DEF extern
+#endif
+
+#if defined(CARGPARSE_IMPLEMENTATION) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+EOF
+mark_api "$header"
+printf '\n#ifdef CARGPARSE_IMPLEMENTATION\n\n'
+mark_api "$source" | grep -v -e '^#define _DEFAULT_SOURCE$' -e '^#include "cargparse.h"$'
+printf '\n#endif /* CARGPARSE_IMPLEMENTATION */\n\n#endif /* CARGPARSE_SINGLE_H */\n'
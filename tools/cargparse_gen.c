@@ -0,0 +1,663 @@
+/* Generates a ready-to-use parser from an option spec:
+ *
+ *   cargparse_gen SPEC OUT_PREFIX    writes OUT_PREFIX.h and OUT_PREFIX.c
+ *
+ * Spec lines ('#' starts a comment, strings are double-quoted with C escapes):
+ *
+ *   name        tool
+ *   usages      "tool [OPTION]... FILE"
+ *   description "Does things."
+ *   epilog      "See also: other(1)."
+ *   option      TYPE SHORT LONG NARGS FLAGS "help"
+ *
+ * TYPE is bool, int, float, str, pos or map; SHORT is a character or '-'; LONG is a name or '-'; NARGS is a
+ * number, '+' (one or more), '*' (zero or more) or '-' (one); FLAGS is none, required, env or required|env.
+ * The name must be a C identifier. Result fields are named after LONG with every character but letters and
+ * digits turned into '_', or opt_<SHORT>, and options whose fields would clash are rejected.
+ *
+ * The generated parser carries its name index prebuilt, so cargparse_parse does no setup work, a typed
+ * result struct filled through the regular getters and the help text rendered ahead of time. */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cargparse.h"
+
+#define GEN_MAX_OPTIONS 4096
+#define GEN_MAX_TOKENS 8
+#define GEN_MAX_IDENT 128
+#define GEN_MAX_LINE 256
+
+typedef struct {
+    cargparse_option_type_e type;
+    char short_name;
+    char *long_name;
+    char *help;
+    int flags;
+    int nargs;
+} gen_option_t;
+
+typedef struct {
+    char *name;
+    char *usages;
+    char *description;
+    char *epilog;
+    gen_option_t options[GEN_MAX_OPTIONS];
+    int n_options;
+} gen_spec_t;
+
+static const char *const TYPE_NAMES[] = {"pos", "bool", "int", "float", "str", "map"};
+static const char *const TYPE_ENUMS[] = {
+    "CARGPARSE_OPTION_TYPE_POS", "CARGPARSE_OPTION_TYPE_BOOL", "CARGPARSE_OPTION_TYPE_INT",
+    "CARGPARSE_OPTION_TYPE_FLOAT", "CARGPARSE_OPTION_TYPE_STR", "CARGPARSE_OPTION_TYPE_MAP",
+};
+
+static int
+_gen_error(const char *path, const int line_no, const char *msg, const char *arg) {
+    fprintf(stderr, "%s:%d: %s%s%s\n", path, line_no, msg, arg ? ": " : "", arg ? arg : "");
+    return -1;
+}
+
+/* Splits a line in place into bare words and quoted strings, quotes are unescaped */
+static int
+_gen_tokenize(char *line, char **tokens, int *n_tokens) {
+    char *src, *dst;
+
+    *n_tokens = 0;
+    for (src = line; *src != '\0';) {
+        while (isspace((unsigned char)*src)) src++;
+        if (*src == '\0' || *src == '#') break;
+        if (*n_tokens == GEN_MAX_TOKENS) return -1;
+
+        if (*src != '"') {
+            tokens[(*n_tokens)++] = src;
+            while (*src != '\0' && !isspace((unsigned char)*src)) src++;
+            if (*src != '\0') *src++ = '\0';
+            continue;
+        }
+
+        dst = ++src;
+        tokens[(*n_tokens)++] = dst;
+        while (*src != '"') {
+            if (*src == '\0') return -1;
+            if (*src == '\\') {
+                src++;
+                switch (*src) {
+                    case 'n':
+                        *dst++ = '\n';
+                        break;
+                    case 't':
+                        *dst++ = '\t';
+                        break;
+                    case '\0':
+                        return -1;
+                    default:
+                        *dst++ = *src;
+                        break;
+                }
+                src++;
+            } else {
+                *dst++ = *src++;
+            }
+        }
+        *dst = '\0';
+        src++;
+    }
+    return 0;
+}
+
+static void
+_gen_field_name(const gen_option_t *opt, char *ident) {
+    size_t i = 0;
+    const char *src = opt->long_name;
+
+    if (!src) {
+        sprintf(ident, "opt_%c", isalnum((unsigned char)opt->short_name) ? opt->short_name : '_');
+        return;
+    }
+    if (isdigit((unsigned char)*src)) ident[i++] = '_';
+    for (; *src != '\0' && i < GEN_MAX_IDENT - 1; src++) {
+        ident[i++] = isalnum((unsigned char)*src) ? *src : '_';
+    }
+    ident[i] = '\0';
+}
+
+/* Struct members of `opt`, a field and `<field>_count` or only the field for bool, returns their number */
+static int
+_gen_members(const gen_option_t *opt, char members[2][GEN_MAX_IDENT + sizeof("_count")]) {
+    _gen_field_name(opt, members[0]);
+    if (opt->type == CARGPARSE_OPTION_TYPE_BOOL) return 1;
+    strcpy(members[1], members[0]);
+    strcat(members[1], "_count");
+    return 2;
+}
+
+/* Mangled names may collide, as dry-run and dry_run or two short names without a letter or digit */
+static const char *
+_gen_find_clash(const gen_spec_t *spec, const gen_option_t *opt) {
+    int i, j, k, n, n_other;
+    static char members[2][GEN_MAX_IDENT + sizeof("_count")];
+    char other[2][GEN_MAX_IDENT + sizeof("_count")];
+
+    n = _gen_members(opt, members);
+    for (i = 0; i < spec->n_options; i++) {
+        n_other = _gen_members(&spec->options[i], other);
+        for (j = 0; j < n; j++) {
+            for (k = 0; k < n_other; k++) {
+                if (strcmp(members[j], other[k]) == 0) return members[j];
+            }
+        }
+    }
+    return NULL;
+}
+
+static int
+_gen_is_identifier(const char *str) {
+    if (!isalpha((unsigned char)*str) && *str != '_') return 0;
+    for (str++; *str != '\0'; str++) {
+        if (!isalnum((unsigned char)*str) && *str != '_') return 0;
+    }
+    return 1;
+}
+
+static int
+_gen_parse_option(gen_option_t *opt, char **tokens, const char *path, const int line_no) {
+    size_t i;
+    char *flag;
+
+    for (i = 0; i < sizeof(TYPE_NAMES) / sizeof(*TYPE_NAMES); i++) {
+        if (strcmp(tokens[1], TYPE_NAMES[i]) == 0) break;
+    }
+    if (i == sizeof(TYPE_NAMES) / sizeof(*TYPE_NAMES)) {
+        return _gen_error(path, line_no, "Unknown type", tokens[1]);
+    }
+    opt->type = (cargparse_option_type_e)i;
+
+    if (strcmp(tokens[2], "-") == 0) {
+        opt->short_name = CARGPARSE_NO_SHORT;
+    } else if (strlen(tokens[2]) == 1 && tokens[2][0] != '-') {
+        opt->short_name = tokens[2][0];
+    } else {
+        return _gen_error(path, line_no, "Short name must be one character or '-'", tokens[2]);
+    }
+    opt->long_name = strcmp(tokens[3], "-") == 0 ? NULL : tokens[3];
+    if (opt->type == CARGPARSE_OPTION_TYPE_POS &&
+        (!opt->long_name || opt->short_name != CARGPARSE_NO_SHORT)) {
+        return _gen_error(path, line_no, "Positional needs a long name and no short name", tokens[3]);
+    }
+
+    if (strcmp(tokens[4], "+") == 0) {
+        opt->nargs = CARGPARSE_NARGS_ONE_OR_MORE;
+    } else if (strcmp(tokens[4], "*") == 0) {
+        opt->nargs = CARGPARSE_NARGS_ZERO_OR_MORE;
+    } else if (strcmp(tokens[4], "-") == 0) {
+        opt->nargs = 1;
+    } else if ((opt->nargs = atoi(tokens[4])) < 1) {
+        return _gen_error(path, line_no, "Invalid nargs", tokens[4]);
+    }
+    if ((opt->type == CARGPARSE_OPTION_TYPE_BOOL || opt->type == CARGPARSE_OPTION_TYPE_MAP) &&
+        opt->nargs != 1) {
+        return _gen_error(path, line_no, "bool and map options take exactly one value", tokens[4]);
+    }
+
+    opt->flags = CARGPARSE_FLAG_NONE;
+    for (flag = strtok(tokens[5], "|"); flag; flag = strtok(NULL, "|")) {
+        if (strcmp(flag, "required") == 0) {
+            opt->flags |= CARGPARSE_FLAG_REQUIRED;
+        } else if (strcmp(flag, "env") == 0) {
+            opt->flags |= CARGPARSE_FLAG_ENV;
+        } else if (strcmp(flag, "none") != 0) {
+            return _gen_error(path, line_no, "Unknown flag", flag);
+        }
+    }
+    opt->help = tokens[6];
+    return 0;
+}
+
+static int
+_gen_parse_spec(gen_spec_t *spec, char *text, const char *path) {
+    int line_no = 0, n_tokens;
+    const char *clash;
+    char *line, *next, *tokens[GEN_MAX_TOKENS];
+
+    for (line = text; line; line = next) {
+        line_no++;
+        if ((next = strchr(line, '\n'))) *next++ = '\0';
+
+        if (_gen_tokenize(line, tokens, &n_tokens) != 0) {
+            return _gen_error(path, line_no, "Malformed line", NULL);
+        }
+        if (n_tokens == 0) continue;
+
+        if (strcmp(tokens[0], "option") == 0) {
+            if (n_tokens != 7) {
+                return _gen_error(path, line_no, "Expected 6 fields after 'option'", NULL);
+            }
+            if (spec->n_options == GEN_MAX_OPTIONS) {
+                return _gen_error(path, line_no, "Too many options", NULL);
+            }
+            if (_gen_parse_option(&spec->options[spec->n_options], tokens, path, line_no) != 0) return -1;
+            if ((clash = _gen_find_clash(spec, &spec->options[spec->n_options]))) {
+                return _gen_error(path, line_no, "Field name clashes with an earlier option", clash);
+            }
+            spec->n_options++;
+        } else if (n_tokens != 2) {
+            return _gen_error(path, line_no, "Expected a single value", tokens[0]);
+        } else if (strcmp(tokens[0], "name") == 0) {
+            if (!_gen_is_identifier(tokens[1])) {
+                return _gen_error(path, line_no, "Name must be a C identifier", tokens[1]);
+            }
+            spec->name = tokens[1];
+        } else if (strcmp(tokens[0], "usages") == 0) {
+            spec->usages = tokens[1];
+        } else if (strcmp(tokens[0], "description") == 0) {
+            spec->description = tokens[1];
+        } else if (strcmp(tokens[0], "epilog") == 0) {
+            spec->epilog = tokens[1];
+        } else {
+            return _gen_error(path, line_no, "Unknown keyword", tokens[0]);
+        }
+    }
+    if (!spec->name) return _gen_error(path, line_no, "Missing 'name'", NULL);
+    if (spec->n_options == 0) return _gen_error(path, line_no, "No options", NULL);
+    return 0;
+}
+
+static void
+_gen_print_string(FILE *out, const char *str) {
+    if (!str) {
+        fputs("NULL", out);
+        return;
+    }
+    fputc('"', out);
+    for (; *str != '\0'; str++) {
+        switch (*str) {
+            case '\n':
+                fputs("\\n", out);
+                break;
+            case '\t':
+                fputs("\\t", out);
+                break;
+            case '"':
+            case '\\':
+                fputc('\\', out);
+                fputc(*str, out);
+                break;
+            default:
+                fputc(*str, out);
+                break;
+        }
+    }
+    fputc('"', out);
+}
+
+static void
+_gen_print_short(FILE *out, const char short_name) {
+    if (short_name == CARGPARSE_NO_SHORT) {
+        fputs("CARGPARSE_NO_SHORT", out);
+    } else if (short_name == '\'' || short_name == '\\') {
+        fprintf(out, "'\\%c'", short_name);
+    } else {
+        fprintf(out, "'%c'", short_name);
+    }
+}
+
+static void
+_gen_print_nargs(FILE *out, const int nargs) {
+    if (nargs == CARGPARSE_NARGS_ONE_OR_MORE) {
+        fputs("CARGPARSE_NARGS_ONE_OR_MORE", out);
+    } else if (nargs == CARGPARSE_NARGS_ZERO_OR_MORE) {
+        fputs("CARGPARSE_NARGS_ZERO_OR_MORE", out);
+    } else {
+        fprintf(out, "%d", nargs);
+    }
+}
+
+static void
+_gen_print_flags(FILE *out, const int flags) {
+    if (flags == CARGPARSE_FLAG_NONE) {
+        fputs("CARGPARSE_FLAG_NONE", out);
+    } else if (flags == (CARGPARSE_FLAG_REQUIRED | CARGPARSE_FLAG_ENV)) {
+        fputs("CARGPARSE_FLAG_REQUIRED | CARGPARSE_FLAG_ENV", out);
+    } else {
+        fputs(flags == CARGPARSE_FLAG_REQUIRED ? "CARGPARSE_FLAG_REQUIRED" : "CARGPARSE_FLAG_ENV", out);
+    }
+}
+
+static int
+_gen_is_variadic(const gen_option_t *opt) {
+    return opt->nargs == CARGPARSE_NARGS_ONE_OR_MORE || opt->nargs == CARGPARSE_NARGS_ZERO_OR_MORE;
+}
+
+/* Options read into typed fields: one value or an array of a fixed count */
+static int
+_gen_is_typed(const gen_option_t *opt) {
+    return opt->type != CARGPARSE_OPTION_TYPE_BOOL && opt->type != CARGPARSE_OPTION_TYPE_MAP &&
+           !_gen_is_variadic(opt);
+}
+
+/* C type of one value in the result struct, followed by the field name */
+static const char *
+_gen_value_type(const cargparse_option_type_e type) {
+    switch (type) {
+        case CARGPARSE_OPTION_TYPE_INT:
+            return "long ";
+        case CARGPARSE_OPTION_TYPE_FLOAT:
+            return "double ";
+        default:
+            return "const char *";
+    }
+}
+
+static void
+_gen_print_help_line(FILE *out, const char *line) {
+    fputs("    ", out);
+    _gen_print_string(out, line);
+    fputc('\n', out);
+}
+
+/* Rendered by cargparse_render_help at the default width, one string literal per line */
+static void
+_gen_print_help_string(FILE *out, const gen_spec_t *spec, const char *help) {
+    char line[GEN_MAX_LINE + 1];
+    const char *end;
+    size_t len;
+
+    fprintf(out, "const char %s_help[] =\n", spec->name);
+    for (; *help != '\0'; help += len) {
+        end = strchr(help, '\n');
+        len = end ? (size_t)(end - help) + 1 : strlen(help);
+        if (len > GEN_MAX_LINE) len = GEN_MAX_LINE;
+        memcpy(line, help, len);
+        line[len] = '\0';
+        _gen_print_help_line(out, line);
+    }
+    fputs("    \"\";\n\n", out);
+}
+
+static const char *
+_gen_zero_value(const cargparse_option_type_e type) {
+    switch (type) {
+        case CARGPARSE_OPTION_TYPE_INT:
+            return "0";
+        case CARGPARSE_OPTION_TYPE_FLOAT:
+            return "0.0";
+        default:
+            return "NULL";
+    }
+}
+
+static int
+_gen_write_header(FILE *out, const gen_spec_t *spec) {
+    int i;
+    char ident[GEN_MAX_IDENT];
+    const gen_option_t *opt;
+
+    fprintf(out, "/* Generated by cargparse_gen, do not edit */\n");
+    fprintf(out, "#ifndef CARGPARSE_GEN_%s_H\n#define CARGPARSE_GEN_%s_H\n\n", spec->name, spec->name);
+    fprintf(out, "#include \"cargparse.h\"\n\n");
+    fprintf(out, "extern cargparse_t %s_parser;\n", spec->name);
+    fprintf(out, "extern const char %s_help[];\n\n", spec->name);
+
+    fprintf(out, "/* `<field>_count` is the number of values got. Options with several values fill an array "
+                 "of their\n * count, variadic ones point at their values in argv (NULL when none was got), "
+                 "map options are\n * read with cargparse_get_map_long or cargparse_get_map_short. */\n");
+    fprintf(out, "typedef struct {\n");
+    for (i = 0; i < spec->n_options; i++) {
+        opt = &spec->options[i];
+        _gen_field_name(opt, ident);
+        if (opt->type == CARGPARSE_OPTION_TYPE_BOOL) {
+            fprintf(out, "    bool %s;\n", ident);
+            continue;
+        }
+        if (_gen_is_variadic(opt) && opt->type != CARGPARSE_OPTION_TYPE_MAP) {
+            fprintf(out, "    char **%s;\n", ident);
+        } else if (_gen_is_typed(opt) && opt->nargs == 1) {
+            fprintf(out, "    %s%s;\n", _gen_value_type(opt->type), ident);
+        } else if (_gen_is_typed(opt)) {
+            fprintf(out, "    %s%s[%d];\n", _gen_value_type(opt->type), ident, opt->nargs);
+        }
+        fprintf(out, "    unsigned %s_count;\n", ident);
+    }
+    fprintf(out, "} %s_args_t;\n\n", spec->name);
+
+    fprintf(out, "cargparse_err_e\n%s_args_parse(%s_args_t *args, const int argc, char **argv);\n\n",
+            spec->name, spec->name);
+    fprintf(out, "void\n%s_print_help(void);\n\n", spec->name);
+    fprintf(out, "#endif\n");
+    return ferror(out) ? -1 : 0;
+}
+
+static int
+_gen_write_source(FILE *out, const gen_spec_t *spec, const char *header_name, const unsigned *words,
+                  const unsigned n_words, const cargparse_option_hot_t *hot, const char *help) {
+    int i;
+    unsigned w;
+    char ident[GEN_MAX_IDENT];
+    const char *getter_name;
+    const gen_option_t *opt;
+
+    fprintf(out, "/* Generated by cargparse_gen, do not edit */\n");
+    fprintf(out, "#include \"%s\"\n\n#include <stdio.h>\n\n", header_name);
+
+    fprintf(out, "static const cargparse_option_t %s_options[%d] = {\n", spec->name, spec->n_options);
+    for (i = 0; i < spec->n_options; i++) {
+        opt = &spec->options[i];
+        fprintf(out, "    CARGPARSE_OPTION_INIT(%s, ", TYPE_ENUMS[opt->type]);
+        _gen_print_short(out, opt->short_name);
+        fputs(", ", out);
+        _gen_print_string(out, opt->long_name);
+        fputs(", ", out);
+        _gen_print_string(out, opt->help);
+        fputs(", ", out);
+        _gen_print_flags(out, opt->flags);
+        fputs(", ", out);
+        _gen_print_nargs(out, opt->nargs);
+        fputs("),\n", out);
+    }
+    fprintf(out, "};\n\n");
+    fprintf(out, "static cargparse_parse_res_t %s_parse_res[%d];\n\n", spec->name, spec->n_options);
+
+    fprintf(out, "/* prebuilt by cargparse_prepare at generation time */\n");
+    fprintf(out, "static unsigned %s_index[%u] = {", spec->name, n_words);
+    for (w = 0; w < n_words; w++) {
+        fprintf(out, "%s%u,", w % 16 == 0 ? "\n    " : " ", words[w]);
+    }
+    fprintf(out, "\n};\n\n");
+    fprintf(out, "static cargparse_option_hot_t %s_hot[%d] = {\n", spec->name, spec->n_options);
+    for (i = 0; i < spec->n_options; i++) {
+        fprintf(out, "    {%uU, %d, %u, %u, %u},\n", hot[i].hash, hot[i].nargs, hot[i].flags, hot[i].type,
+                hot[i].name_len);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "cargparse_t %s_parser = {\n    ", spec->name);
+    _gen_print_string(out, spec->usages);
+    fputs(",\n    ", out);
+    _gen_print_string(out, spec->description);
+    fputs(",\n    ", out);
+    _gen_print_string(out, spec->epilog);
+    fprintf(out, ",\n    %s_options,\n    %s_parse_res,\n    %d,\n", spec->name, spec->name, spec->n_options);
+    fprintf(out, "    {%s_index, %u, true, %s_hot},\n", spec->name, n_words, spec->name);
+    fprintf(out, "    NULL,\n    NULL,\n    0,\n    NULL,\n    NULL,\n    NULL,\n};\n\n");
+
+    _gen_print_help_string(out, spec, help);
+
+    fprintf(out, "void\n%s_print_help(void) {\n    fputs(%s_help, stdout);\n}\n\n", spec->name, spec->name);
+
+    fprintf(out, "cargparse_err_e\n%s_args_parse(%s_args_t *args, const int argc, char **argv) {\n",
+            spec->name, spec->name);
+    for (i = 0; i < spec->n_options; i++) {
+        if (_gen_is_typed(&spec->options[i]) && spec->options[i].nargs > 1) break;
+    }
+    if (i < spec->n_options) fprintf(out, "    unsigned i;\n");
+    fprintf(out, "    cargparse_err_e ret = cargparse_parse(&%s_parser, argc, argv);\n\n", spec->name);
+    fprintf(out, "    if (ret != CARGPARSE_OK && ret != CARGPARSE_GOT_ZERO_ARGS) return ret;\n\n");
+    for (i = 0; i < spec->n_options; i++) {
+        opt = &spec->options[i];
+        _gen_field_name(opt, ident);
+        if (opt->type == CARGPARSE_OPTION_TYPE_BOOL) {
+            fprintf(out, "    args->%s = %s_parse_res[%d].is_got;\n", ident, spec->name, i);
+            continue;
+        }
+        fprintf(out, "    args->%s_count = %s_parse_res[%d].is_got ? (unsigned)%s_parse_res[%d].nargs : 0;\n",
+                ident, spec->name, i, spec->name, i);
+        if (_gen_is_variadic(opt) && opt->type != CARGPARSE_OPTION_TYPE_MAP) {
+            fprintf(out, "    args->%s = args->%s_count ? %s_parse_res[%d].valuestr : NULL;\n", ident, ident,
+                    spec->name, i);
+            continue;
+        }
+        if (!_gen_is_typed(opt)) continue;
+
+        switch (opt->type) {
+            case CARGPARSE_OPTION_TYPE_INT:
+                getter_name = "int";
+                break;
+            case CARGPARSE_OPTION_TYPE_FLOAT:
+                getter_name = "float";
+                break;
+            case CARGPARSE_OPTION_TYPE_POS:
+                getter_name = NULL;
+                break;
+            default:
+                getter_name = "str";
+                break;
+        }
+        /* arrays are read value by value, missing ones get the zero default */
+        if (opt->nargs > 1) fprintf(out, "    for (i = 0; i < %d; i++) {\n    ", opt->nargs);
+        if (getter_name && opt->long_name) {
+            fprintf(out, "    cargparse_get_%s_long(&%s_parser, ", getter_name, spec->name);
+            _gen_print_string(out, opt->long_name);
+        } else if (getter_name) {
+            fprintf(out, "    cargparse_get_%s_short(&%s_parser, ", getter_name, spec->name);
+            _gen_print_short(out, opt->short_name);
+        } else {
+            fprintf(out, "    cargparse_get_positional(&%s_parser, ", spec->name);
+            _gen_print_string(out, opt->long_name);
+        }
+        if (opt->nargs > 1) {
+            fprintf(out, ", &args->%s[i], %s, i);\n    }\n", ident, _gen_zero_value(opt->type));
+        } else {
+            fprintf(out, ", &args->%s, %s, 0);\n", ident, _gen_zero_value(opt->type));
+        }
+    }
+    fprintf(out, "\n    return ret;\n}\n");
+    return ferror(out) ? -1 : 0;
+}
+
+static char *
+_gen_read_file(const char *path) {
+    FILE *in;
+    long size;
+    char *text;
+
+    if (!(in = fopen(path, "rb"))) return NULL;
+    if (fseek(in, 0, SEEK_END) != 0 || (size = ftell(in)) < 0 || fseek(in, 0, SEEK_SET) != 0) {
+        fclose(in);
+        return NULL;
+    }
+    if ((text = malloc((size_t)size + 1)) && fread(text, 1, (size_t)size, in) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    if (text) text[size] = '\0';
+    fclose(in);
+    return text;
+}
+
+/* The index and help text are built by the library itself, so the generated tables always match its lookups
+ * and the help matches cargparse_print_help */
+static int
+_gen_build_index(const gen_spec_t *spec, unsigned **words, unsigned *n_words, cargparse_option_hot_t **hot,
+                 char **help) {
+    int i, ret = -1;
+    size_t help_size;
+    cargparse_option_t *options;
+    cargparse_parse_res_t *parse_res;
+
+    *n_words = CARGPARSE_INDEX_SIZE(spec->n_options);
+    options = malloc(sizeof(cargparse_option_t) * spec->n_options);
+    parse_res = calloc((size_t)spec->n_options, sizeof(cargparse_parse_res_t));
+    *words = malloc(sizeof(unsigned) * *n_words);
+    *hot = malloc(sizeof(cargparse_option_hot_t) * spec->n_options);
+    *help = NULL;
+
+    if (options && parse_res && *words && *hot) {
+        for (i = 0; i < spec->n_options; i++) {
+            const cargparse_option_t opt = {spec->options[i].type,      spec->options[i].short_name,
+                                            spec->options[i].long_name, spec->options[i].help,
+                                            spec->options[i].flags,     spec->options[i].nargs};
+            memcpy(&options[i], &opt, sizeof(opt));
+        }
+        {
+            cargparse_t parser = {
+                spec->usages, spec->description, spec->epilog, options, parse_res, spec->n_options,
+                {*words, *n_words, false, *hot}, NULL, NULL, 0, NULL, NULL, NULL
+            };
+            cargparse_prepare(&parser);
+            cargparse_render_help(&parser, 0, NULL, 0, &help_size);
+            *help = malloc(help_size);
+            if (parser.index.is_built && *help &&
+                cargparse_render_help(&parser, 0, *help, help_size, &help_size) == CARGPARSE_OK) {
+                ret = 0;
+            }
+        }
+    }
+    free(options);
+    free(parse_res);
+    return ret;
+}
+
+int
+main(int argc, char **argv) {
+    int ret = 1;
+    size_t prefix_len;
+    char *text, *path, *header_name, *help = NULL;
+    unsigned *words = NULL, n_words;
+    cargparse_option_hot_t *hot = NULL;
+    FILE *out;
+    gen_spec_t *spec;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s SPEC OUT_PREFIX\n", argv[0]);
+        return 2;
+    }
+    spec = calloc(1, sizeof(gen_spec_t));
+    if (!spec || !(text = _gen_read_file(argv[1]))) {
+        fprintf(stderr, "%s: cannot read spec\n", argv[1]);
+        return 1;
+    }
+    if (_gen_parse_spec(spec, text, argv[1]) != 0 ||
+        _gen_build_index(spec, &words, &n_words, &hot, &help) != 0) {
+        return 1;
+    }
+
+    prefix_len = strlen(argv[2]);
+    path = malloc(prefix_len + 3);
+    header_name = strrchr(argv[2], '/') ? strrchr(argv[2], '/') + 1 : argv[2];
+    sprintf(path, "%s.h", argv[2]);
+    if ((out = fopen(path, "w"))) {
+        ret = _gen_write_header(out, spec) != 0;
+        ret |= fclose(out) != 0;
+    }
+    sprintf(path, "%s.c", argv[2]);
+    if (!ret && (out = fopen(path, "w"))) {
+        char header_file[GEN_MAX_IDENT + 3];
+
+        sprintf(header_file, "%.*s.h", GEN_MAX_IDENT, header_name);
+        ret = _gen_write_source(out, spec, header_file, words, n_words, hot, help) != 0;
+        ret |= fclose(out) != 0;
+    } else {
+        ret = 1;
+    }
+    if (ret) fprintf(stderr, "%s: cannot write output\n", path);
+
+    free(path);
+    free(words);
+    free(hot);
+    free(help);
+    free(text);
+    free(spec);
+    return ret;
+}